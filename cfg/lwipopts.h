@@ -673,7 +673,7 @@
  * LWIP_DHCP==1: Enable DHCP module.
  */
 #ifndef LWIP_DHCP
-#define LWIP_DHCP                       0
+#define LWIP_DHCP                       1
 #endif
 
 /**
@@ -1123,7 +1123,7 @@
  * changes its up/down status (i.e., due to DHCP IP acquistion)
  */
 #ifndef LWIP_NETIF_STATUS_CALLBACK
-#define LWIP_NETIF_STATUS_CALLBACK      0
+#define LWIP_NETIF_STATUS_CALLBACK      1
 #endif
 
 /**
@@ -1863,6 +1863,20 @@
  * that case, ip_route() continues as normal.
  */
 
+/**
+ * LWIP_HOOK_FILENAME: Declarations of the hooks below, see net/net.c.
+ */
+#define LWIP_HOOK_FILENAME              "net_hooks.h"
+
+/**
+ * LWIP_HOOK_DHCP_APPEND_OPTIONS, LWIP_HOOK_DHCP_PARSE_OPTION: DHCP Rapid
+ * Commit support.
+ */
+#define LWIP_HOOK_DHCP_APPEND_OPTIONS(netif, dhcp, state, msg, msg_type, options_len_ptr) \
+  net_dhcp_append_options(netif, dhcp, state, msg, msg_type, options_len_ptr)
+#define LWIP_HOOK_DHCP_PARSE_OPTION(netif, dhcp, state, msg, msg_type, option, len, pbuf, offset) \
+  net_dhcp_parse_option(netif, dhcp, state, msg, msg_type, option, len, pbuf, offset)
+
 /*
    ---------------------------------------
    ---------- Debugging options ----------
@@ -2124,4 +2138,12 @@
 #define DNS_DEBUG                       LWIP_DBG_OFF
 #endif
 
+/**
+ * LWIP_LINK_POLL_INTERVAL: Period of the lwipthread link status poll, it
+ * bounds the delay between the end of autonegotiation and link up.
+ */
+#ifndef LWIP_LINK_POLL_INTERVAL
+#define LWIP_LINK_POLL_INTERVAL         TIME_MS2I(100)
+#endif
+
 #endif /* __LWIPOPT_H__ */
@@ -601,7 +601,7 @@
  * @note    The default is @p FALSE.
  */
 #if !defined(CH_DBG_FILL_THREADS)
-#define CH_DBG_FILL_THREADS                 FALSE
+#define CH_DBG_FILL_THREADS                 TRUE
 #endif
 
 /**
@@ -639,7 +639,7 @@
  *          just before interrupts are enabled globally.
  */
 #define CH_CFG_SYSTEM_INIT_HOOK() {                                         \
-  /* Add threads initialization code here.*/                                \
+  cpu_init();                                                               \
 }
 
 /**
@@ -647,7 +647,17 @@
  * @details User fields added to the end of the @p thread_t structure.
  */
 #define CH_CFG_THREAD_EXTRA_FIELDS                                          \
-  /* Add threads custom fields here.*/
+  uint64_t cpu_cycles;                                                      \
+  uint64_t cpu_mark;                                                        \
+  uint32_t cpu_load[3];                                                     \
+  uint64_t inv_ready;                                                       \
+  uint64_t inv_mark;                                                        \
+  uint32_t inv_since;                                                       \
+  uint32_t inv_block;                                                       \
+  void *inv_object;                                                         \
+  struct ch_thread *inv_server;                                             \
+  struct ch_thread *inv_preemptor;                                          \
+  bool inv_preempted;
 
 /**
  * @brief   Threads initialization hook.
@@ -657,7 +667,17 @@
  *          the threads creation APIs.
  */
 #define CH_CFG_THREAD_INIT_HOOK(tp) {                                       \
-  /* Add threads initialization code here.*/                                \
+  (tp)->cpu_cycles = 0;                                                     \
+  (tp)->cpu_mark = 0;                                                       \
+  (tp)->cpu_load[0] = (tp)->cpu_load[1] = (tp)->cpu_load[2] = 0;            \
+  (tp)->inv_ready = 0;                                                      \
+  (tp)->inv_mark = 0;                                                       \
+  (tp)->inv_since = 0;                                                      \
+  (tp)->inv_block = 0;                                                      \
+  (tp)->inv_object = NULL;                                                  \
+  (tp)->inv_server = NULL;                                                  \
+  (tp)->inv_preemptor = NULL;                                               \
+  (tp)->inv_preempted = false;                                              \
 }
 
 /**
@@ -673,21 +693,25 @@
  * @details This hook is invoked just before switching between threads.
  */
 #define CH_CFG_CONTEXT_SWITCH_HOOK(ntp, otp) {                              \
-  /* Context switch code here.*/                                            \
+  cpu_switch(ntp, otp);                                                     \
+  trace_switch(ntp);                                                        \
+  inversion_switch(ntp, otp);                                               \
 }
 
 /**
  * @brief   ISR enter hook.
  */
 #define CH_CFG_IRQ_PROLOGUE_HOOK() {                                        \
-  /* IRQ prologue code here.*/                                              \
+  trace_irq_enter();                                                        \
+  irq_enter();                                                              \
 }
 
 /**
  * @brief   ISR exit hook.
  */
 #define CH_CFG_IRQ_EPILOGUE_HOOK() {                                        \
-  /* IRQ epilogue code here.*/                                              \
+  irq_leave();                                                              \
+  trace_irq_leave();                                                        \
 }
 
 /**
@@ -697,7 +721,7 @@
  * @note    This macro can be used to activate a power saving mode.
  */
 #define CH_CFG_IDLE_ENTER_HOOK() {                                          \
-  /* Idle-enter code here.*/                                                \
+  load_idle_enter();                                                        \
 }
 
 /**
@@ -707,7 +731,7 @@
  * @note    This macro can be used to deactivate a power saving mode.
  */
 #define CH_CFG_IDLE_LEAVE_HOOK() {                                          \
-  /* Idle-leave code here.*/                                                \
+  load_idle_leave();                                                        \
 }
 
 /**
@@ -751,6 +775,10 @@
 /* Port-specific settings (override port settings defaulted in chcore.h).    */
 /*===========================================================================*/
 
+#if !defined(_FROM_ASM_)
+#include "prof.h"
+#endif
+
 #endif  /* CHCONF_H */
 
 /** @} */
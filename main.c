@@ -25,6 +25,19 @@
 
 #include "lwipthread.h"
 #include "web/web.h"
+#include "web/events.h"
+#include "status/status.h"
+#include "telemetry/telemetry.h"
+#include "metrics/metrics.h"
+#include "net/net.h"
+#include "prof/boot.h"
+#include "prof/cpu.h"
+#include "prof/heap.h"
+#include "prof/inversion.h"
+#include "prof/irq.h"
+#include "prof/locks.h"
+#include "prof/sampler.h"
+#include "prof/stacks.h"
 
 
 #include "portab.h"
@@ -36,6 +49,15 @@
 #define SHELL_WA_SIZE   THD_WORKING_AREA_SIZE(2048)
 
 static const ShellCommand commands[] = {
+  {"boot", cmd_boot},
+  {"top", cmd_top},
+  {"irq", cmd_irq},
+  {"stacks", cmd_stacks},
+  {"locks", cmd_locks},
+  {"allocs", cmd_allocs},
+  {"samples", cmd_samples},
+  {"inversions", cmd_inversions},
+  {"telemetry", cmd_telemetry},
   {NULL, NULL}
 };
 
@@ -85,24 +107,34 @@ int main(void) {
   };
   event_listener_t el0;
 
+  boot_start();
+
   /*
    * System initializations.
    * - HAL initialization, this also initializes the configured device drivers
    *   and performs the board-specific initializations.
    * - Kernel initialization, the main() function becomes a thread and the
    *   RTOS is active.
-   * - lwIP subsystem initialization using the default configuration.
+   * - lwIP subsystem initialization, started in its own thread so that
+   *   the services below start during the PHY autonegotiation.
    */
   halInit();
+  boot_mark(BOOT_HAL);
   chSysInit();
+  boot_mark(BOOT_KERNEL);
+  stacks_paint_main();
+  irq_probe_start();
+  sampler_start();
 
   /* lwip */
-  lwipInit(NULL);
+  chThdCreateStatic(wa_net, sizeof(wa_net), NET_THREAD_PRIORITY,
+                    net_thread, NULL);
 
   /*
    * Target-dependent setup code.
    */
   portab_setup();
+  boot_mark(BOOT_PORTAB);
 
   /*
    * Activates the serial driver 3 using the driver default configuration.
@@ -121,6 +153,32 @@ int main(void) {
    */
   chThdCreateStatic(waThread1, sizeof(waThread1), NORMALPRIO, Thread1, NULL);
 
+  /*
+   * Creates the status sampler thread.
+   */
+  chThdCreateStatic(wa_status, sizeof(wa_status), STATUS_THREAD_PRIORITY,
+                    status_thread, NULL);
+
+  /*
+   * Creates the telemetry frames producer for /events.
+   */
+  chThdCreateStatic(wa_events, sizeof(wa_events), EVENTS_THREAD_PRIORITY,
+                    events_thread, NULL);
+
+  /*
+   * Creates the UDP telemetry publisher.
+   */
+  chThdCreateStatic(wa_telemetry, sizeof(wa_telemetry),
+                    TELEMETRY_THREAD_PRIORITY, telemetry_thread, NULL);
+
+#if STACKS_WATCHDOG
+  /*
+   * Creates the stack peaks watchdog.
+   */
+  chThdCreateStatic(wa_stacks, sizeof(wa_stacks), STACKS_THREAD_PRIORITY,
+                    stacks_thread, NULL);
+#endif
+
   /*
    * Creates the HTTPS thread (it changes priority internally).
    */
@@ -0,0 +1,425 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file metrics.c
+ * @brief Metrics registry and Prometheus exposition code.
+ * @details Writers never lock, counters and histograms are updated with
+ *          relaxed atomic operations on the shard of the calling thread and
+ *          readers add the shards up. Histograms are log-linear so they
+ *          have a fixed size whatever the range of the values and merge by
+ *          adding buckets.
+ *          The exposition text is produced line by line into the caller
+ *          buffer and flushed whenever it fills up, the memory used by a
+ *          scrape does not depend on the number of metrics.
+ * @addtogroup METRICS
+ * @{
+ */
+
+#include <stdarg.h>
+#include <string.h>
+
+#include "ch.h"
+
+#include "hal.h" /* chprintf */
+#include "chprintf.h" /* chprintf */
+
+#include "lwip/opt.h"
+#include "lwip/stats.h"
+
+#include "status.h"
+#include "metrics.h"
+
+typedef struct metrics_proto {
+  const char *name;
+  const struct stats_proto *stats;
+} metrics_proto_t;
+
+static metric_t *metrics_head;
+static metric_t *metrics_tail;
+
+static status_t metrics_status;
+
+static histogram_t metrics_histogram;
+
+#if LWIP_STATS
+static const metrics_proto_t metrics_protos[] = {
+#if LINK_STATS
+  {"link", &lwip_stats.link},
+#endif
+#if ETHARP_STATS
+  {"etharp", &lwip_stats.etharp},
+#endif
+#if IP_STATS
+  {"ip", &lwip_stats.ip},
+#endif
+#if ICMP_STATS
+  {"icmp", &lwip_stats.icmp},
+#endif
+#if UDP_STATS
+  {"udp", &lwip_stats.udp},
+#endif
+#if TCP_STATS
+  {"tcp", &lwip_stats.tcp},
+#endif
+  {NULL, NULL},
+};
+#endif
+
+static void metrics_flush(metrics_writer_t *writer) {
+  if (writer->len > 0) {
+    writer->flush(writer->arg, writer->data, writer->len);
+    writer->len = 0;
+  }
+}
+
+static void metrics_family(metrics_writer_t *writer, const char *name,
+                           const char *help, const char *type) {
+  metrics_printf(writer, "# HELP %s %s\n# TYPE %s %s\n",
+                 name, help, name, type);
+}
+
+/* One sample line, @p label and @p extra are "key=\"value\"" or empty.*/
+static void metrics_sample(metrics_writer_t *writer, const char *name,
+                           const char *suffix, const char *label,
+                           const char *extra, uint32_t value) {
+  if (label[0] != '\0' && extra[0] != '\0') {
+    metrics_printf(writer, "%s%s{%s,%s} %lu\n", name, suffix, label, extra,
+                   (unsigned long)value);
+  } else if (label[0] != '\0' || extra[0] != '\0') {
+    metrics_printf(writer, "%s%s{%s} %lu\n", name, suffix,
+                   label[0] != '\0' ? label : extra, (unsigned long)value);
+  } else {
+    metrics_printf(writer, "%s%s %lu\n", name, suffix, (unsigned long)value);
+  }
+}
+
+static void metrics_render_metric(metrics_writer_t *writer,
+                                  const metric_t *metric,
+                                  const metric_t *previous) {
+  static const char *types[] = {"counter", "gauge", "histogram", "summary"};
+  static const char *quantiles[] = {"0.5", "0.9", "0.99"};
+  static const uint32_t permilles[] = {500, 900, 990};
+  histogram_t *histogram = &metrics_histogram;
+  char label[48] = "";
+  char extra[24];
+  uint32_t count = 0;
+
+  if (previous == NULL || strcmp(previous->name, metric->name) != 0) {
+    metrics_family(writer, metric->name, metric->help, types[metric->type]);
+  }
+  if (metric->label_name != NULL) {
+    chsnprintf(label, sizeof(label), "%s=\"%s\"", metric->label_name,
+               metric->label_value);
+  }
+
+  if (metric->type == METRIC_COUNTER || metric->type == METRIC_GAUGE) {
+    metrics_sample(writer, metric->name, "", label, "", metric_value(metric));
+    return;
+  }
+
+  metric_snapshot(metric, histogram);
+  if (metric->type == METRIC_SUMMARY) {
+    for (unsigned i = 0; i < sizeof(permilles) / sizeof(permilles[0]); i++) {
+      chsnprintf(extra, sizeof(extra), "quantile=\"%s\"", quantiles[i]);
+      metrics_sample(writer, metric->name, "", label, extra,
+                     histogram_quantile(histogram, permilles[i]));
+    }
+    metrics_sample(writer, metric->name, "", label, "quantile=\"1\"",
+                   histogram->max);
+  } else {
+    /* Exposed with one bucket per power of two, the sub-buckets are only
+       used by the on device quantiles.*/
+    for (int i = 0; i < METRICS_BUCKETS - 1; i++) {
+      count += histogram->buckets[i];
+      if (((i + 1) & ((1 << METRICS_SUB_BITS) - 1)) == 0) {
+        chsnprintf(extra, sizeof(extra), "le=\"%lu\"",
+                   (unsigned long)histogram_upper(i));
+        metrics_sample(writer, metric->name, "_bucket", label, extra, count);
+      }
+    }
+    metrics_sample(writer, metric->name, "_bucket", label, "le=\"+Inf\"",
+                   histogram->count);
+  }
+  metrics_sample(writer, metric->name, "_sum", label, "", histogram->sum);
+  metrics_sample(writer, metric->name, "_count", label, "", histogram->count);
+}
+
+static void metrics_render_system(metrics_writer_t *writer) {
+  static const char *states[] = {CH_STATE_NAMES};
+  static const char *windows[] = {"1s", "10s", "60s"};
+  status_t *status = &metrics_status;
+
+  status_read(status);
+
+  metrics_family(writer, "chibios_uptime_seconds",
+                 "Time since boot.", "counter");
+  metrics_printf(writer, "chibios_uptime_seconds %lu\n",
+                 (unsigned long)TIME_I2S(chVTGetSystemTimeX()));
+
+  metrics_family(writer, "chibios_heap_free_bytes",
+                 "Free bytes in the default heap.", "gauge");
+  metrics_printf(writer, "chibios_heap_free_bytes %lu\n",
+                 (unsigned long)status->system.heap_free);
+  metrics_family(writer, "chibios_heap_largest_bytes",
+                 "Largest free block in the default heap.", "gauge");
+  metrics_printf(writer, "chibios_heap_largest_bytes %lu\n",
+                 (unsigned long)status->system.heap_largest);
+  metrics_family(writer, "chibios_heap_fragments",
+                 "Free blocks in the default heap.", "gauge");
+  metrics_printf(writer, "chibios_heap_fragments %lu\n",
+                 (unsigned long)status->system.heap_fragments);
+  metrics_family(writer, "chibios_core_free_bytes",
+                 "Unallocated core memory.", "gauge");
+  metrics_printf(writer, "chibios_core_free_bytes %lu\n",
+                 (unsigned long)status->system.core_free);
+
+  metrics_family(writer, "chibios_cpu_load_ratio",
+                 "Share of the cycles not spent idle.", "gauge");
+  for (int i = 0; i < 3; i++) {
+    metrics_printf(writer, "chibios_cpu_load_ratio{window=\"%s\"} %u.%03u\n",
+                   windows[i], status->system.load[i] / 1000,
+                   status->system.load[i] % 1000);
+  }
+
+  metrics_family(writer, "chibios_thread_priority",
+                 "Thread priority, labelled with the thread state.", "gauge");
+  for (int i = 0; i < status->system.thread_count; i++) {
+    status_thread_t *thread = &status->system.threads[i];
+    metrics_printf(writer,
+                   "chibios_thread_priority{thread=\"%s\",state=\"%s\"} %u\n",
+                   thread->name, states[thread->state],
+                   (unsigned int)thread->prio);
+  }
+
+  if (status->net.pool_count > 0) {
+    metrics_family(writer, "lwip_pool_used",
+                   "Used elements of the lwIP pools.", "gauge");
+    for (int i = 0; i < status->net.pool_count; i++) {
+      metrics_printf(writer, "lwip_pool_used{pool=\"%s\"} %u\n",
+                     status->net.pools[i].name, status->net.pools[i].used);
+    }
+    metrics_family(writer, "lwip_pool_max",
+                   "Highest use of the lwIP pools.", "gauge");
+    for (int i = 0; i < status->net.pool_count; i++) {
+      metrics_printf(writer, "lwip_pool_max{pool=\"%s\"} %u\n",
+                     status->net.pools[i].name, status->net.pools[i].max);
+    }
+    metrics_family(writer, "lwip_pool_avail",
+                   "Size of the lwIP pools.", "gauge");
+    for (int i = 0; i < status->net.pool_count; i++) {
+      metrics_printf(writer, "lwip_pool_avail{pool=\"%s\"} %u\n",
+                     status->net.pools[i].name, status->net.pools[i].avail);
+    }
+    metrics_family(writer, "lwip_pool_errors_total",
+                   "Failed allocations from the lwIP pools.", "counter");
+    for (int i = 0; i < status->net.pool_count; i++) {
+      metrics_printf(writer, "lwip_pool_errors_total{pool=\"%s\"} %u\n",
+                     status->net.pools[i].name, status->net.pools[i].err);
+    }
+  }
+}
+
+#if LWIP_STATS
+#define METRICS_PROTO(writer, family, labels, proto, field)                 \
+  metrics_printf(writer, family "{proto=\"%s\"," labels "} %lu\n",         \
+                 (proto)->name, (unsigned long)(proto)->stats->field)
+
+static void metrics_render_lwip(metrics_writer_t *writer) {
+  const metrics_proto_t *proto;
+
+  if (metrics_protos[0].name == NULL) {
+    return;
+  }
+
+  metrics_family(writer, "lwip_packets_total",
+                 "Packets by protocol and direction.", "counter");
+  for (proto = metrics_protos; proto->name; proto++) {
+    METRICS_PROTO(writer, "lwip_packets_total", "dir=\"xmit\"", proto, xmit);
+    METRICS_PROTO(writer, "lwip_packets_total", "dir=\"recv\"", proto, recv);
+    METRICS_PROTO(writer, "lwip_packets_total", "dir=\"drop\"", proto, drop);
+  }
+
+  metrics_family(writer, "lwip_errors_total",
+                 "Protocol errors by kind.", "counter");
+  for (proto = metrics_protos; proto->name; proto++) {
+    METRICS_PROTO(writer, "lwip_errors_total", "kind=\"chksum\"", proto, chkerr);
+    METRICS_PROTO(writer, "lwip_errors_total", "kind=\"len\"", proto, lenerr);
+    METRICS_PROTO(writer, "lwip_errors_total", "kind=\"mem\"", proto, memerr);
+    METRICS_PROTO(writer, "lwip_errors_total", "kind=\"route\"", proto, rterr);
+    METRICS_PROTO(writer, "lwip_errors_total", "kind=\"proto\"", proto, proterr);
+    METRICS_PROTO(writer, "lwip_errors_total", "kind=\"opt\"", proto, opterr);
+    METRICS_PROTO(writer, "lwip_errors_total", "kind=\"misc\"", proto, err);
+  }
+}
+#endif
+
+/**
+ * @brief Adds @p metric to the exposition.
+ */
+void metrics_register(metric_t *metric) {
+  metric->next = NULL;
+
+  chSysLock();
+  if (metrics_tail) {
+    metrics_tail->next = metric;
+  } else {
+    metrics_head = metric;
+  }
+  metrics_tail = metric;
+  chSysUnlock();
+}
+
+/**
+ * @brief Sum of the shards of a counter or the value of a gauge.
+ */
+uint32_t metric_value(const metric_t *metric) {
+  uint32_t value = 0;
+
+  for (int i = 0; i < metric->shards; i++) {
+    value += __atomic_load_n(&metric->values[i], __ATOMIC_RELAXED);
+  }
+  return value;
+}
+
+/**
+ * @brief Merges the shards of a histogram into @p snapshot.
+ * @note  Shards keep changing while being read, @p count is taken from
+ *        the buckets so the snapshot is self consistent.
+ */
+void metric_snapshot(const metric_t *metric, histogram_t *snapshot) {
+  memset(snapshot, 0, sizeof(*snapshot));
+  for (int i = 0; i < metric->shards; i++) {
+    histogram_merge(snapshot, &metric->histograms[i]);
+  }
+  snapshot->count = 0;
+  for (int i = 0; i < METRICS_BUCKETS; i++) {
+    snapshot->count += snapshot->buckets[i];
+  }
+}
+
+/**
+ * @brief Adds @p src to @p dst.
+ */
+void histogram_merge(histogram_t *dst, const histogram_t *src) {
+  uint32_t max = __atomic_load_n(&src->max, __ATOMIC_RELAXED);
+
+  for (int i = 0; i < METRICS_BUCKETS; i++) {
+    dst->buckets[i] += __atomic_load_n(&src->buckets[i], __ATOMIC_RELAXED);
+  }
+  dst->count += __atomic_load_n(&src->count, __ATOMIC_RELAXED);
+  dst->sum += __atomic_load_n(&src->sum, __ATOMIC_RELAXED);
+  if (max > dst->max) {
+    dst->max = max;
+  }
+}
+
+/**
+ * @brief Largest value recorded in bucket @p index.
+ */
+uint32_t histogram_upper(int index) {
+  int k;
+  uint32_t sub;
+
+  if (index < (1 << METRICS_SUB_BITS)) {
+    return (uint32_t)index;
+  }
+  k = (index >> METRICS_SUB_BITS) + METRICS_SUB_BITS - 1;
+  sub = (uint32_t)(index & ((1 << METRICS_SUB_BITS) - 1)) |
+        (1U << METRICS_SUB_BITS);
+  return ((sub + 1) << (k - METRICS_SUB_BITS)) - 1;
+}
+
+/**
+ * @brief Value below which @p permille of the observations fall.
+ * @return The upper bound of the bucket reaching the rank, never more
+ *         than the recorded maximum.
+ */
+uint32_t histogram_quantile(const histogram_t *histogram, uint32_t permille) {
+  uint32_t rank = (uint32_t)(((uint64_t)histogram->count * permille + 999) /
+                             1000);
+  uint32_t count = 0;
+
+  if (histogram->count == 0) {
+    return 0;
+  }
+  if (rank == 0) {
+    rank = 1;
+  }
+  for (int i = 0; i < METRICS_BUCKETS - 1; i++) {
+    count += histogram->buckets[i];
+    if (count >= rank) {
+      uint32_t upper = histogram_upper(i);
+      return upper < histogram->max ? upper : histogram->max;
+    }
+  }
+  return histogram->max;
+}
+
+/**
+ * @brief Formats into the writer, flushing it first if the line does not
+ *        fit. Lines longer than the buffer are truncated.
+ */
+void metrics_printf(metrics_writer_t *writer, const char *fmt, ...) {
+  va_list ap;
+  int n;
+
+  va_start(ap, fmt);
+  n = chvsnprintf(writer->data + writer->len, writer->size - writer->len,
+                  fmt, ap);
+  va_end(ap);
+
+  if (writer->len + n < writer->size) {
+    writer->len += n;
+    return;
+  }
+
+  metrics_flush(writer);
+  va_start(ap, fmt);
+  n = chvsnprintf(writer->data, writer->size, fmt, ap);
+  va_end(ap);
+  writer->len = (size_t)n < writer->size ? (size_t)n : writer->size - 1;
+}
+
+/**
+ * @brief Streams the Prometheus text exposition through @p data.
+ * @details Registered metrics come first, then the system and lwIP
+ *          families.
+ */
+void metrics_render(char *data, size_t size, metrics_flush_t flush,
+                    void *arg) {
+  metrics_writer_t *writer = &(metrics_writer_t) {
+    .data = data,
+    .size = size,
+    .len = 0,
+    .flush = flush,
+    .arg = arg,
+  };
+
+  for (metric_t *metric = metrics_head, *previous = NULL; metric;
+       previous = metric, metric = metric->next) {
+    metrics_render_metric(writer, metric, previous);
+  }
+
+  metrics_render_system(writer);
+#if LWIP_STATS
+  metrics_render_lwip(writer);
+#endif
+
+  metrics_flush(writer);
+}
+
+/** @} */
@@ -0,0 +1,214 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file metrics.h
+ * @brief Metrics registry macros and structures.
+ * @addtogroup METRICS
+ * @{
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Histogram sub-buckets per power of two are 2^METRICS_SUB_BITS,
+ *        the relative error of a recorded value is below 2^-SUB_BITS.
+ */
+#ifndef METRICS_SUB_BITS
+#define METRICS_SUB_BITS        3
+#endif
+
+/**
+ * @brief Values from 2^METRICS_MAX_BITS up are counted in the last bucket.
+ * @details There is no separate overflow bucket, the last bucket is also
+ *          the top sub-bucket of 2^(METRICS_MAX_BITS - 1). Quantiles that
+ *          fall in it are reported as at most 2^METRICS_MAX_BITS - 1, the
+ *          max field keeps the largest value.
+ */
+#ifndef METRICS_MAX_BITS
+#define METRICS_MAX_BITS        20
+#endif
+
+#define METRICS_BUCKETS                                                     \
+  ((METRICS_MAX_BITS - METRICS_SUB_BITS + 1) << METRICS_SUB_BITS)
+
+/**
+ * @brief Declares a counter whose writers are spread over @p n words.
+ * @note  The metric must still be passed to metrics_register().
+ */
+#define METRIC_COUNTER_DECL(var, metric_name, metric_help, n)               \
+  static uint32_t var##_values[n];                                          \
+  metric_t var = {                                                          \
+    .name = (metric_name),                                                  \
+    .help = (metric_help),                                                  \
+    .type = METRIC_COUNTER,                                                 \
+    .shards = (n),                                                          \
+    .values = var##_values,                                                 \
+  }
+
+#define METRIC_GAUGE_DECL(var, metric_name, metric_help)                    \
+  static uint32_t var##_values[1];                                          \
+  metric_t var = {                                                          \
+    .name = (metric_name),                                                  \
+    .help = (metric_help),                                                  \
+    .type = METRIC_GAUGE,                                                   \
+    .shards = 1,                                                            \
+    .values = var##_values,                                                 \
+  }
+
+/**
+ * @brief Declares a log-linear histogram with @p n shards.
+ */
+#define METRIC_HISTOGRAM_DECL(var, metric_name, metric_help, n)             \
+  static histogram_t var##_histograms[n];                                   \
+  metric_t var = {                                                          \
+    .name = (metric_name),                                                  \
+    .help = (metric_help),                                                  \
+    .type = METRIC_HISTOGRAM,                                               \
+    .shards = (n),                                                          \
+    .histograms = var##_histograms,                                         \
+  }
+
+typedef enum {
+  METRIC_COUNTER,
+  METRIC_GAUGE,
+  METRIC_HISTOGRAM,
+  METRIC_SUMMARY,
+} metric_type_t;
+
+/**
+ * @brief Log-linear histogram, also the layout of its snapshots.
+ * @details Values below 2^METRICS_SUB_BITS have their own bucket, each
+ *          following power of two up to 2^METRICS_MAX_BITS is split in
+ *          2^METRICS_SUB_BITS buckets. Larger values are merged into
+ *          the last one, bucket METRICS_BUCKETS - 1, which with the
+ *          defaults is bucket 143 and counts every value from 983040 up.
+ */
+typedef struct histogram {
+  uint32_t buckets[METRICS_BUCKETS];
+  uint32_t count;
+  uint32_t sum;
+  uint32_t max;
+} histogram_t;
+
+/**
+ * @brief A metric, each writer thread updates one of its @p shards with
+ *        relaxed atomic operations, readers add the shards up.
+ * @details Metrics of one family share the name and differ by their
+ *          label, they must be registered one after the other. Summaries
+ *          are histograms exposed as their quantiles and maximum.
+ */
+typedef struct metric {
+  const char *name;
+  const char *help;
+  metric_type_t type;
+  const char *label_name;
+  const char *label_value;
+  int shards;
+  uint32_t *values;
+  histogram_t *histograms;
+  struct metric *next;
+} metric_t;
+
+typedef void (*metrics_flush_t)(void *arg, const char *data, size_t len);
+
+/**
+ * @brief Exposition writer, output goes through a fixed buffer.
+ */
+typedef struct metrics_writer {
+  char *data;
+  size_t size;
+  size_t len;
+  metrics_flush_t flush;
+  void *arg;
+} metrics_writer_t;
+
+/**
+ * @brief Shard of the calling thread, threads hash to a fixed shard.
+ */
+static inline int metrics_shard(const metric_t *metric) {
+  uint32_t self = (uint32_t)(uintptr_t)chThdGetSelfX();
+  return metric->shards == 1 ? 0 : (int)((self >> 3) % metric->shards);
+}
+
+static inline int histogram_index(uint32_t value) {
+  int k;
+
+  if (value < (1U << METRICS_SUB_BITS)) {
+    return (int)value;
+  }
+  k = 31 - __builtin_clz(value);
+  if (k >= METRICS_MAX_BITS) {
+    return METRICS_BUCKETS - 1;
+  }
+  return ((k - METRICS_SUB_BITS + 1) << METRICS_SUB_BITS) +
+         (int)((value >> (k - METRICS_SUB_BITS)) &
+               ((1U << METRICS_SUB_BITS) - 1));
+}
+
+/**
+ * @brief Adds @p value to a counter, lock free.
+ */
+static inline void metric_add(metric_t *metric, uint32_t value) {
+  __atomic_fetch_add(&metric->values[metrics_shard(metric)], value,
+                     __ATOMIC_RELAXED);
+}
+
+static inline void metric_set(metric_t *metric, uint32_t value) {
+  __atomic_store_n(&metric->values[0], value, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Records @p value in a histogram, lock free.
+ */
+static inline void metric_observe(metric_t *metric, uint32_t value) {
+  histogram_t *histogram = &metric->histograms[metrics_shard(metric)];
+  uint32_t max = __atomic_load_n(&histogram->max, __ATOMIC_RELAXED);
+
+  __atomic_fetch_add(&histogram->buckets[histogram_index(value)], 1,
+                     __ATOMIC_RELAXED);
+  __atomic_fetch_add(&histogram->count, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&histogram->sum, value, __ATOMIC_RELAXED);
+  while (value > max &&
+         !__atomic_compare_exchange_n(&histogram->max, &max, value, true,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+  }
+}
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void metrics_register(metric_t *metric);
+  uint32_t metric_value(const metric_t *metric);
+  void metric_snapshot(const metric_t *metric, histogram_t *snapshot);
+  void histogram_merge(histogram_t *dst, const histogram_t *src);
+  uint32_t histogram_upper(int index);
+  uint32_t histogram_quantile(const histogram_t *histogram, uint32_t permille);
+  void metrics_printf(metrics_writer_t *writer, const char *fmt, ...);
+  void metrics_render(char *data, size_t size, metrics_flush_t flush,
+                      void *arg);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* METRICS_H */
+
+/** @} */
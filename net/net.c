@@ -0,0 +1,331 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file net.c
+ * @brief Network bring-up code.
+ * @details lwipInit() blocks until the MAC and the stack are up, running it
+ *          from its own thread lets main() start the services meanwhile.
+ *          Services only wait in net_wait() before their first netconn
+ *          call, everything else they set up overlaps the bring-up and the
+ *          PHY autonegotiation.
+ *          With NET_DHCP the address of the last lease is kept in the
+ *          backup SRAM, which survives resets while the backup domain is
+ *          powered. DHCP is started before link up with that address, so
+ *          the link up sends a DHCPREQUEST for it (INIT-REBOOT, RFC 2131
+ *          3.2) instead of a DHCPDISCOVER and the interface is configured
+ *          after one round trip. lwIP falls back to a discovery on DHCPNAK
+ *          or when the request is not answered. This needs lwIP 2.1, see
+ *          net_dhcp_force().
+ * @addtogroup NET
+ * @{
+ */
+
+#include "ch.h"
+#include "hal.h"
+
+#include "lwipthread.h"
+#include "lwip/init.h"
+#include "lwip/tcpip.h"
+#include "lwip/dhcp.h"
+#include "lwip/prot/dhcp.h"
+
+#include "net.h"
+#include "net_hooks.h"
+#include "boot.h"
+
+static SEMAPHORE_DECL(net_ready, 0);
+
+/*
+ * INIT-REBOOT into the cached lease and Rapid Commit both need fields of
+ * struct dhcp that only lwIP's dhcp.c is meant to write, there is no public
+ * entry point for either. They are enabled only for lwIP 2.1, whose state
+ * machine net_dhcp_force() was checked against. With another version DHCP
+ * always starts with a DHCPDISCOVER and Rapid Commit is not requested.
+ */
+#if LWIP_VERSION >= LWIP_MAKE_VERSION(2, 1, 0, 0) &&                        \
+    LWIP_VERSION < LWIP_MAKE_VERSION(2, 2, 0, 0)
+#define NET_DHCP_PRIVATE            TRUE
+#else
+#define NET_DHCP_PRIVATE            FALSE
+#endif
+
+#define NET_DHCP_RAPID                                                      \
+  (NET_DHCP && NET_DHCP_RAPID_COMMIT && NET_DHCP_PRIVATE)
+
+#if NET_DHCP
+#define NET_LEASE_MAGIC         0x4c454153U
+
+/**
+ * @brief Last DHCP lease, addresses in network order.
+ */
+typedef struct net_lease {
+  uint32_t magic;
+  uint32_t address;
+  uint32_t server;
+  uint32_t check;
+} net_lease_t;
+
+/* Not initialized by the startup code.*/
+static net_lease_t net_lease __attribute__((section(".ram5")));
+
+static uint32_t net_lease_check(const net_lease_t *lease) {
+
+  return lease->magic ^ (lease->address << 1 | lease->address >> 31) ^
+         (lease->server << 2 | lease->server >> 30);
+}
+
+/*
+ * Status callback, runs in the tcpip thread. The address is set by the
+ * DHCP bind, the state is already BOUND.
+ */
+static void net_status(struct netif *netif) {
+  struct dhcp *dhcp = netif_dhcp_data(netif);
+
+  if (!dhcp_supplied_address(netif)) {
+    return;
+  }
+  boot_mark(BOOT_ADDRESS);
+  net_lease.magic = NET_LEASE_MAGIC;
+  net_lease.address = ip4_addr_get_u32(netif_ip4_addr(netif));
+  net_lease.server = ip4_addr_get_u32(ip_2_ip4(&dhcp->server_ip_addr));
+  net_lease.check = net_lease_check(&net_lease);
+}
+
+#if NET_DHCP_PRIVATE
+/*
+ * The only writes to lwIP's DHCP client state, runs in the tcpip thread.
+ * Moves the client to @p state; a non-zero @p address becomes the offered
+ * address and a non-zero @p server the server identifier, both in network
+ * order. lwIP 2.1 sends the next message from these fields:
+ * - REBOOTING, on link up, a DHCPREQUEST for the offered address;
+ * - REQUESTING takes a DHCPACK, which lwIP otherwise drops while selecting.
+ */
+static void net_dhcp_force(struct dhcp *dhcp, u8_t state, u32_t address,
+                           u32_t server) {
+
+  dhcp->state = state;
+  if (address != 0U) {
+    ip4_addr_set_u32(&dhcp->offered_ip_addr, address);
+  }
+  if (server != 0U) {
+    ip_addr_set_ip4_u32(&dhcp->server_ip_addr, server);
+  }
+}
+#endif /* NET_DHCP_PRIVATE */
+
+/*
+ * Starts DHCP, runs in the tcpip thread. Before link up dhcp_start() only
+ * allocates the client, the REBOOTING state set here makes
+ * netif_set_link_up() do an INIT-REBOOT. If the link is already up a
+ * DHCPDISCOVER is out, its offer is ignored in the REBOOTING state.
+ */
+static void net_dhcp_start(void *p) {
+  struct netif *netif = netif_default;
+
+  (void)p;
+  netif_set_status_callback(netif, net_status);
+  if (dhcp_start(netif) != ERR_OK) {
+    return;
+  }
+#if NET_DHCP_PRIVATE
+  if (net_lease.magic != NET_LEASE_MAGIC ||
+      net_lease.check != net_lease_check(&net_lease)) {
+    return;
+  }
+  net_dhcp_force(netif_dhcp_data(netif), DHCP_STATE_REBOOTING,
+                 net_lease.address, net_lease.server);
+  if (netif_is_link_up(netif)) {
+    dhcp_network_changed(netif);
+  }
+#endif
+}
+
+#if NET_DHCP_RAPID
+/*
+ * Server identifier in network order, 0 if not found. lwIP only reads it
+ * from a DHCPOFFER. Options past the first pbuf are not searched, renewals
+ * then fail and the lease is kept by rebinding.
+ */
+static u32_t net_dhcp_server(struct dhcp_msg *msg, struct pbuf *p) {
+  u16_t offset = DHCP_OPTIONS_OFS;
+
+  if (p->payload != (void *)msg) {
+    return 0U;
+  }
+  while (offset + 2U <= p->tot_len) {
+    u8_t option = pbuf_get_at(p, offset);
+    u8_t len;
+
+    if (option == DHCP_OPTION_PAD) {
+      offset++;
+      continue;
+    }
+    if (option == DHCP_OPTION_END) {
+      return 0U;
+    }
+    len = pbuf_get_at(p, offset + 1U);
+    if (option == DHCP_OPTION_SERVER_ID && len == 4U &&
+        offset + 6U <= p->tot_len) {
+      u32_t server = (u32_t)pbuf_get_at(p, offset + 2U) << 24 |
+                     (u32_t)pbuf_get_at(p, offset + 3U) << 16 |
+                     (u32_t)pbuf_get_at(p, offset + 4U) << 8 |
+                     (u32_t)pbuf_get_at(p, offset + 5U);
+
+      return lwip_htonl(server);
+    }
+    offset += 2U + len;
+  }
+  return 0U;
+}
+#endif /* NET_DHCP_RAPID */
+#endif /* NET_DHCP */
+
+/**
+ * @brief Adds the Rapid Commit option to DHCPDISCOVER.
+ */
+void net_dhcp_append_options(struct netif *netif, struct dhcp *dhcp,
+                             u8_t state, struct dhcp_msg *msg,
+                             u8_t msg_type, u16_t *options_len) {
+
+  (void)netif;
+  (void)dhcp;
+  (void)state;
+#if NET_DHCP_RAPID
+  /* Two bytes and the end option.*/
+  if (msg_type == DHCP_DISCOVER && *options_len + 3U <= DHCP_OPTIONS_LEN) {
+    msg->options[(*options_len)++] = NET_DHCP_OPTION_RAPID_COMMIT;
+    msg->options[(*options_len)++] = 0;
+  }
+#else
+  (void)msg;
+  (void)msg_type;
+  (void)options_len;
+#endif
+}
+
+/**
+ * @brief Accepts a DHCPACK with Rapid Commit as the answer to DHCPDISCOVER.
+ * @details The client is moved to REQUESTING while the message is parsed,
+ *          lwIP then handles the DHCPACK as the answer to a DHCPREQUEST.
+ *          Servers put the message type first, @p msg_type is known here.
+ */
+void net_dhcp_parse_option(struct netif *netif, struct dhcp *dhcp,
+                           u8_t state, struct dhcp_msg *msg,
+                           u8_t msg_type, u8_t option, u8_t len,
+                           struct pbuf *p, u16_t offset) {
+
+  (void)netif;
+  (void)len;
+  (void)offset;
+#if NET_DHCP_RAPID
+  if (option == NET_DHCP_OPTION_RAPID_COMMIT &&
+      state == DHCP_STATE_SELECTING && msg_type == DHCP_ACK) {
+    net_dhcp_force(dhcp, DHCP_STATE_REQUESTING, 0U,
+                   net_dhcp_server(msg, p));
+  }
+#else
+  (void)dhcp;
+  (void)state;
+  (void)msg;
+  (void)msg_type;
+  (void)option;
+  (void)p;
+#endif
+}
+
+/*
+ * Link up callback, runs in the lwIP thread.
+ */
+static void net_link_up(void *p) {
+
+  boot_mark(BOOT_LINK);
+#if NET_DHCP
+  /* netif_set_link_up() already resumed the DHCP client.*/
+  (void)p;
+#else
+  lwipDefaultLinkUpCB(p);
+#endif
+}
+
+/*
+ * Link down callback, runs in the lwIP thread.
+ */
+static void net_link_down(void *p) {
+
+#if NET_DHCP
+  /* The lease is kept, the next link up does an INIT-REBOOT.*/
+  (void)p;
+#else
+  lwipDefaultLinkDownCB(p);
+#endif
+}
+
+THD_WORKING_AREA(wa_net, NET_THREAD_STACK_SIZE);
+
+THD_FUNCTION(net_thread, p) {
+  static uint8_t macaddress[6] = {
+    LWIP_ETHADDR_0, LWIP_ETHADDR_1, LWIP_ETHADDR_2,
+    LWIP_ETHADDR_3, LWIP_ETHADDR_4, LWIP_ETHADDR_5
+  };
+  static lwipthread_opts_t opts = {
+    .macaddress = macaddress,
+#if NET_DHCP
+    .addrMode = NET_ADDRESS_DHCP,
+#else
+    .addrMode = NET_ADDRESS_STATIC,
+#endif
+    .link_up_cb = net_link_up,
+    .link_down_cb = net_link_down,
+  };
+
+  (void)p;
+  chRegSetThreadName("net");
+
+#if !NET_DHCP
+  {
+    ip4_addr_t address, netmask, gateway;
+
+    LWIP_IPADDR(&address);
+    LWIP_NETMASK(&netmask);
+    LWIP_GATEWAY(&gateway);
+    opts.address = address.addr;
+    opts.netmask = netmask.addr;
+    opts.gateway = gateway.addr;
+  }
+#endif
+  lwipInit(&opts);
+  boot_mark(BOOT_LWIP);
+#if NET_DHCP
+  tcpip_callback(net_dhcp_start, NULL);
+#endif
+
+  chSemSignal(&net_ready);
+}
+
+/**
+ * @brief Waits until the stack accepts netconn calls.
+ * @details Returns immediately once the bring-up is done, the link may
+ *          still be down: listeners bound before link up serve the first
+ *          request as soon as it comes up.
+ */
+void net_wait(void) {
+
+  chSemWait(&net_ready);
+  chSemSignal(&net_ready);
+}
+
+/** @} */
@@ -0,0 +1,69 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file net.h
+ * @brief Network bring-up macros and structures.
+ * @addtogroup NET
+ * @{
+ */
+
+#ifndef NET_H
+#define NET_H
+
+#ifndef NET_THREAD_STACK_SIZE
+#define NET_THREAD_STACK_SIZE       512
+#endif
+
+/**
+ * @brief Above the services so the stack starts as soon as main() yields.
+ */
+#ifndef NET_THREAD_PRIORITY
+#define NET_THREAD_PRIORITY         (NORMALPRIO + 3)
+#endif
+
+/**
+ * @brief Address from DHCP instead of LWIP_IPADDR.
+ */
+#ifndef NET_DHCP
+#define NET_DHCP                    LWIP_DHCP
+#endif
+
+/**
+ * @brief Asks for Rapid Commit (RFC 4039) in DHCPDISCOVER, servers that
+ *        support it answer with a DHCPACK instead of a DHCPOFFER.
+ * @note  Only honoured with lwIP 2.1, see net_dhcp_force().
+ */
+#ifndef NET_DHCP_RAPID_COMMIT
+#define NET_DHCP_RAPID_COMMIT       FALSE
+#endif
+
+#define NET_DHCP_OPTION_RAPID_COMMIT 80
+
+extern THD_WORKING_AREA(wa_net, NET_THREAD_STACK_SIZE);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  THD_FUNCTION(net_thread, p);
+  void net_wait(void);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NET_H */
+
+/** @} */
@@ -0,0 +1,49 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file net_hooks.h
+ * @brief lwIP hooks, included by the lwIP sources through
+ *        LWIP_HOOK_FILENAME.
+ * @addtogroup NET
+ * @{
+ */
+
+#ifndef NET_HOOKS_H
+#define NET_HOOKS_H
+
+struct netif;
+struct dhcp;
+struct dhcp_msg;
+struct pbuf;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void net_dhcp_append_options(struct netif *netif, struct dhcp *dhcp,
+                               u8_t state, struct dhcp_msg *msg,
+                               u8_t msg_type, u16_t *options_len);
+  void net_dhcp_parse_option(struct netif *netif, struct dhcp *dhcp,
+                             u8_t state, struct dhcp_msg *msg,
+                             u8_t msg_type, u8_t option, u8_t len,
+                             struct pbuf *p, u16_t offset);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NET_HOOKS_H */
+
+/** @} */
@@ -0,0 +1,182 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file boot.c
+ * @brief Boot time profiler code.
+ * @details main() and the services mark the stages of the boot as they
+ *          reach them, later marks of a stage are ignored. Times come from
+ *          the cycle counter until the kernel runs and from the system
+ *          time after it, the counter wraps in less than a minute.
+ *          The record is mirrored in the backup SRAM, which survives
+ *          resets while the backup domain is powered, so the boot before
+ *          a reset can still be read. The backup SRAM is clocked by
+ *          halInit(), the previous record is taken over at that stage.
+ * @addtogroup PROF_BOOT
+ * @{
+ */
+
+#include <string.h>
+
+#include "ch.h"
+#include "hal.h"
+
+#include "chprintf.h"
+#include "shell.h"
+
+#include "cpu.h"
+#include "boot.h"
+
+#define BOOT_MAGIC              0x424f4f54U
+
+static boot_record_t boot_current;
+
+static boot_record_t boot_previous;
+
+/* Not initialized by the startup code.*/
+static boot_record_t boot_retained __attribute__((section(".ram5")));
+
+static bool boot_retaining;
+
+static systime_t boot_kernel_time;
+
+static uint32_t boot_kernel_us;
+
+static uint32_t boot_check(const boot_record_t *record) {
+  const uint32_t *words = (const uint32_t *)record;
+  uint32_t check = 0;
+
+  for (size_t i = 0; i < offsetof(boot_record_t, check) / 4; i++) {
+    check = (check << 1 | check >> 31) ^ words[i];
+  }
+  return check;
+}
+
+/**
+ * @brief Starts the cycle counter and marks the start of main().
+ */
+void boot_start(void) {
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+  boot_current.magic = BOOT_MAGIC;
+  boot_current.cause = RCC->CSR >> BOOT_CAUSE_SHIFT;
+  RCC->CSR |= RCC_CSR_RMVF;
+  boot_mark(BOOT_MAIN);
+}
+
+/**
+ * @brief Marks @p stage as reached now, from any thread.
+ */
+void boot_mark(boot_stage_t stage) {
+  /* BOOT_KERNEL is set by main() before any other thread exists, after it
+     the stages are tested and set under the kernel lock.*/
+  bool locked = boot_current.reached & (1U << BOOT_KERNEL);
+  uint32_t us;
+
+  if (locked) {
+    chSysLock();
+  }
+  if (boot_current.reached & (1U << stage)) {
+    if (locked) {
+      chSysUnlock();
+    }
+    return;
+  }
+  if (locked) {
+    us = boot_kernel_us +
+         TIME_I2US(chTimeDiffX(boot_kernel_time, chVTGetSystemTimeX()));
+  } else {
+    us = CPU_CYCLES() / (CPU_CYCLES_HZ / 1000000);
+  }
+  if (stage == BOOT_KERNEL) {
+    boot_kernel_time = chVTGetSystemTimeX();
+    boot_kernel_us = us;
+  }
+  if (stage == BOOT_HAL) {
+    if (boot_retained.magic == BOOT_MAGIC &&
+        boot_retained.check == boot_check(&boot_retained)) {
+      boot_previous = boot_retained;
+      boot_current.count = boot_previous.count;
+    }
+    boot_current.count++;
+    boot_retaining = true;
+  }
+
+  boot_current.us[stage] = us;
+  boot_current.reached |= 1U << stage;
+  boot_current.check = boot_check(&boot_current);
+  if (boot_retaining) {
+    boot_retained = boot_current;
+  }
+  if (locked) {
+    chSysUnlock();
+  }
+}
+
+/**
+ * @brief Copies this boot and the one before the last reset.
+ * @return false if there is no record of a previous boot.
+ */
+bool boot_read(boot_record_t *current, boot_record_t *previous) {
+  chSysLock();
+  *current = boot_current;
+  *previous = boot_previous;
+  chSysUnlock();
+  return previous->magic == BOOT_MAGIC;
+}
+
+static void boot_print(BaseSequentialStream *chp, const char *title,
+                       const boot_record_t *record) {
+  static const char *stages[] = {BOOT_STAGE_NAMES};
+  static const char *causes[] = {BOOT_CAUSE_NAMES};
+
+  chprintf(chp, "%s boot %lu, reset", title, record->count);
+  for (unsigned i = 0; i < sizeof(causes) / sizeof(causes[0]); i++) {
+    if (record->cause & (1U << i)) {
+      chprintf(chp, " %s", causes[i]);
+    }
+  }
+  chprintf(chp, SHELL_NEWLINE_STR);
+  for (int i = 0; i < BOOT_STAGES; i++) {
+    if (record->reached & (1U << i)) {
+      chprintf(chp, "  %-8s %8lu.%03lu ms" SHELL_NEWLINE_STR, stages[i],
+               record->us[i] / 1000, record->us[i] % 1000);
+    }
+  }
+}
+
+/**
+ * @brief Shell command, "boot" prints the stage times of this boot and of
+ *        the previous one.
+ */
+void cmd_boot(BaseSequentialStream *chp, int argc, char *argv[]) {
+  boot_record_t current, previous;
+
+  (void)argv;
+  if (argc > 0) {
+    chprintf(chp, "Usage: boot" SHELL_NEWLINE_STR);
+    return;
+  }
+
+  if (boot_read(&current, &previous)) {
+    boot_print(chp, "previous", &previous);
+  }
+  boot_print(chp, "current", &current);
+}
+
+/** @} */
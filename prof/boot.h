@@ -0,0 +1,79 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file boot.h
+ * @brief Boot time profiler macros and structures.
+ * @addtogroup PROF_BOOT
+ * @{
+ */
+
+#ifndef BOOT_H
+#define BOOT_H
+
+typedef enum {
+  BOOT_MAIN,
+  BOOT_HAL,
+  BOOT_KERNEL,
+  BOOT_LWIP,
+  BOOT_PORTAB,
+  BOOT_LISTEN,
+  BOOT_LINK,
+  BOOT_ADDRESS,
+  BOOT_ACCEPT,
+  BOOT_SERVED,
+  BOOT_STAGES
+} boot_stage_t;
+
+#define BOOT_STAGE_NAMES                                                    \
+  "main", "hal", "kernel", "lwip", "portab", "listen", "link", "address",   \
+  "accept", "served"
+
+/**
+ * @brief Reset flags, the top byte of RCC_CSR.
+ */
+#define BOOT_CAUSE_NAMES                                                    \
+  "bor", "pin", "por", "software", "iwdg", "wwdg", "lowpower"
+#define BOOT_CAUSE_SHIFT        25
+
+/**
+ * @brief One boot, times in us from the start of main().
+ * @details Only the stages set in @p reached have a time. The time before
+ *          main(), clock and memory initialization, is not measured.
+ */
+typedef struct boot_record {
+  uint32_t magic;
+  uint32_t count;
+  uint32_t cause;
+  uint32_t reached;
+  uint32_t us[BOOT_STAGES];
+  uint32_t check;
+} boot_record_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void boot_start(void);
+  void boot_mark(boot_stage_t stage);
+  bool boot_read(boot_record_t *current, boot_record_t *previous);
+  void cmd_boot(BaseSequentialStream *chp, int argc, char *argv[]);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BOOT_H */
+
+/** @} */
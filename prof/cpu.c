@@ -0,0 +1,169 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file cpu.c
+ * @brief Per thread CPU accounting code.
+ * @details The context switch hook charges the cycles elapsed since the
+ *          previous switch to the thread being switched out. Once per
+ *          window the status thread turns the cycles of each thread into
+ *          its share of the window and into exponentially decaying
+ *          averages with 10 s and 60 s time constants. Interrupt time is
+ *          charged to the interrupted thread.
+ * @addtogroup PROF_CPU
+ * @{
+ */
+
+#include <stdlib.h>
+
+#include "ch.h"
+#include "hal.h"
+
+#include "chprintf.h"
+#include "shell.h"
+
+#include "prof.h"
+#include "cpu.h"
+
+static uint32_t cpu_last;
+
+static uint32_t cpu_window_cycles;
+
+static systime_t cpu_window_time;
+
+static uint32_t cpu_decay(uint32_t average, uint32_t load, int32_t period) {
+  return (uint32_t)((int32_t)average + ((int32_t)load - (int32_t)average) /
+                    period);
+}
+
+/**
+ * @brief Starts the cycle counter, called from chSysInit().
+ * @note  The counter is not cleared, the boot profiler may have started
+ *        it earlier.
+ */
+void cpu_init(void) {
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+  cpu_last = CPU_CYCLES();
+  cpu_window_cycles = cpu_last;
+}
+
+/**
+ * @brief Context switch hook, called in the kernel critical zone.
+ */
+void cpu_switch(thread_t *ntp, thread_t *otp) {
+  uint32_t now = CPU_CYCLES();
+
+  (void)ntp;
+  otp->cpu_cycles += now - cpu_last;
+  cpu_last = now;
+}
+
+/**
+ * @brief Closes the load window if CPU_WINDOW_MS elapsed.
+ * @return true if the thread loads were updated.
+ */
+bool cpu_window(void) {
+  systime_t now = chVTGetSystemTimeX();
+  uint32_t cycles, elapsed;
+  thread_t *tp;
+
+  if (chTimeDiffX(cpu_window_time, now) < TIME_MS2I(CPU_WINDOW_MS)) {
+    return false;
+  }
+  cpu_window_time = now;
+
+  /* Every cycle of the window is charged to some thread, idle included.*/
+  chSysLock();
+  cpu_switch(currp, currp);
+  cycles = CPU_CYCLES();
+  chSysUnlock();
+  elapsed = cycles - cpu_window_cycles;
+  cpu_window_cycles = cycles;
+  if (elapsed == 0) {
+    return false;
+  }
+
+  tp = chRegFirstThread();
+  while (tp) {
+    uint64_t delta;
+    uint32_t load;
+
+    chSysLock();
+    delta = tp->cpu_cycles - tp->cpu_mark;
+    tp->cpu_mark = tp->cpu_cycles;
+    chSysUnlock();
+
+    if (delta > elapsed) {
+      delta = elapsed;
+    }
+    load = (uint32_t)((delta << 16) / elapsed);
+    tp->cpu_load[0] = load;
+    tp->cpu_load[1] = cpu_decay(tp->cpu_load[1], load, 10);
+    tp->cpu_load[2] = cpu_decay(tp->cpu_load[2], load, 60);
+
+    tp = chRegNextThread(tp);
+  }
+  return true;
+}
+
+static void cpu_print_load(BaseSequentialStream *chp, uint32_t load) {
+  uint32_t permille = CPU_PERMILLE(load);
+  chprintf(chp, " %3lu.%lu", permille / 10, permille % 10);
+}
+
+/**
+ * @brief Shell command, "top [count]" prints the thread loads @p count
+ *        times, once per window.
+ */
+void cmd_top(BaseSequentialStream *chp, int argc, char *argv[]) {
+  static const char *states[] = {CH_STATE_NAMES};
+  long count = 1;
+
+  if (argc > 1) {
+    chprintf(chp, "Usage: top [count]" SHELL_NEWLINE_STR);
+    return;
+  }
+  if (argc == 1) {
+    count = strtol(argv[0], NULL, 10);
+  }
+
+  while (count-- > 0) {
+    thread_t *tp;
+
+    chprintf(chp, "name             prio state        1s   10s   60s"
+                  "   Mcycles" SHELL_NEWLINE_STR);
+    tp = chRegFirstThread();
+    while (tp) {
+      chprintf(chp, "%-16s %4lu %-9s",
+               tp->name ? tp->name : "",
+               (uint32_t)tp->prio,
+               states[tp->state]);
+      for (int i = 0; i < CPU_LOADS; i++) {
+        cpu_print_load(chp, tp->cpu_load[i]);
+      }
+      chprintf(chp, " %9lu" SHELL_NEWLINE_STR,
+               (uint32_t)(tp->cpu_cycles / 1000000));
+      tp = chRegNextThread(tp);
+    }
+    if (count > 0) {
+      chprintf(chp, SHELL_NEWLINE_STR);
+      chThdSleepMilliseconds(CPU_WINDOW_MS);
+    }
+  }
+}
+
+/** @} */
@@ -0,0 +1,68 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file cpu.h
+ * @brief Per thread CPU accounting macros and structures.
+ * @addtogroup PROF_CPU
+ * @{
+ */
+
+#ifndef CPU_H
+#define CPU_H
+
+/**
+ * @brief Shortest interval between two load windows.
+ */
+#ifndef CPU_WINDOW_MS
+#define CPU_WINDOW_MS           1000
+#endif
+
+/**
+ * @brief Cycle counter, DWT CYCCNT on the Cortex-M.
+ * @note  Requires hal.h.
+ */
+#define CPU_CYCLES()            (DWT->CYCCNT)
+
+/**
+ * @brief Frequency of CPU_CYCLES().
+ */
+#ifndef CPU_CYCLES_HZ
+#define CPU_CYCLES_HZ           STM32_HCLK
+#endif
+
+/**
+ * @brief Load windows kept per thread, 1 s and decaying 10 s and 60 s.
+ */
+#define CPU_LOADS               3
+
+/**
+ * @brief Converts a load fraction to permille.
+ */
+#define CPU_PERMILLE(load)      ((uint32_t)(((uint64_t)(load) * 1000 + 32768) >> 16))
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  bool cpu_window(void);
+  void cmd_top(BaseSequentialStream *chp, int argc, char *argv[]);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CPU_H */
+
+/** @} */
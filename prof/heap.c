@@ -0,0 +1,295 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file heap.c
+ * @brief Allocation profiler code.
+ * @details The USE_HEAP_PROFILE=yes build links the kernel heap and core
+ *          allocators and the lwIP heap through the __wrap_ functions
+ *          below. Each allocation is charged to its call site, the return
+ *          address of the wrapper, and the block is remembered with its
+ *          size so the free can be charged back. The blocks are kept in a
+ *          table rather than in a header so the profiled build has the
+ *          same heap layout as the normal one. lwIP's mem_calloc() calls
+ *          mem_malloc() from the same file and is not seen.
+ *          chHeapAlloc(), chCoreAlloc() and the other kernel allocation
+ *          helpers are static inline functions around the wrapped ones.
+ *          The return address is their caller only when they are inlined,
+ *          which the optimized builds do. An out-of-line copy, as at -O0,
+ *          charges every allocation it makes to one site inside the copy,
+ *          in the object file of the callers.
+ *          Without the build option only the report is compiled and it
+ *          only shows the heap fragmentation.
+ * @addtogroup PROF_HEAP
+ * @{
+ */
+
+#include <string.h>
+
+#include "ch.h"
+#include "hal.h"
+
+#include "chprintf.h"
+#include "shell.h"
+
+#include "lwip/mem.h"
+
+#include "heap.h"
+
+typedef struct heap_block {
+  const void *p;
+  uint16_t site;
+  uint32_t size;
+} heap_block_t;
+
+#if HEAP_PROFILE
+static heap_site_t heap_sites[HEAP_SITES];
+
+static int heap_sites_count;
+
+static heap_block_t heap_blocks[HEAP_BLOCKS];
+
+static uint32_t heap_overflow;
+
+static uint32_t heap_untracked;
+
+static heap_stats_t heap_snapshot;
+
+/* Called in the kernel critical zone.*/
+static heap_site_t *heap_find(const void *site, heap_kind_t kind) {
+  for (int i = 0; i < heap_sites_count; i++) {
+    if (heap_sites[i].site == site && heap_sites[i].kind == kind) {
+      return &heap_sites[i];
+    }
+  }
+  if (heap_sites_count >= HEAP_SITES) {
+    heap_overflow++;
+    return NULL;
+  }
+  heap_sites[heap_sites_count].site = site;
+  heap_sites[heap_sites_count].kind = kind;
+  return &heap_sites[heap_sites_count++];
+}
+
+/* Called in the kernel critical zone after the real allocator returned.*/
+static void heap_allocated(const void *site, heap_kind_t kind,
+                           const void *p, size_t size) {
+  heap_site_t *hs = heap_find(site, kind);
+
+  if (hs == NULL) {
+    return;
+  }
+  if (p == NULL) {
+    hs->failed++;
+    return;
+  }
+  hs->count++;
+  hs->bytes += size;
+  if (kind != HEAP_CORE) {
+    int i;
+
+    for (i = 0; i < HEAP_BLOCKS; i++) {
+      if (heap_blocks[i].p == NULL) {
+        break;
+      }
+    }
+    if (i == HEAP_BLOCKS) {
+      /* Its free could not be charged back, the live bytes skip it.*/
+      heap_untracked++;
+      return;
+    }
+    heap_blocks[i].p = p;
+    heap_blocks[i].site = hs - heap_sites;
+    heap_blocks[i].size = size;
+  }
+  hs->live += size;
+  if (hs->live > hs->peak) {
+    hs->peak = hs->live;
+  }
+}
+
+/* Called in the kernel critical zone, untracked blocks are ignored.*/
+static void heap_freed(const void *p) {
+  if (p == NULL) {
+    return;
+  }
+  for (int i = 0; i < HEAP_BLOCKS; i++) {
+    if (heap_blocks[i].p == p) {
+      heap_sites[heap_blocks[i].site].live -= heap_blocks[i].size;
+      heap_blocks[i].p = NULL;
+      return;
+    }
+  }
+}
+
+void *__real_chHeapAllocAligned(memory_heap_t *heapp, size_t size,
+                                unsigned align);
+void __real_chHeapFree(void *p);
+void *__real_chCoreAllocAlignedWithOffset(size_t size, unsigned align,
+                                          size_t offset);
+void *__real_chCoreAllocAlignedWithOffsetI(size_t size, unsigned align,
+                                           size_t offset);
+void *__real_mem_malloc(mem_size_t size);
+void __real_mem_free(void *mem);
+void *__real_mem_trim(void *mem, mem_size_t size);
+
+void *__wrap_chHeapAllocAligned(memory_heap_t *heapp, size_t size,
+                                unsigned align) {
+  void *p = __real_chHeapAllocAligned(heapp, size, align);
+
+  chSysLock();
+  heap_allocated(__builtin_return_address(0), HEAP_CHIBIOS, p, size);
+  chSysUnlock();
+  return p;
+}
+
+void __wrap_chHeapFree(void *p) {
+  chSysLock();
+  heap_freed(p);
+  chSysUnlock();
+  __real_chHeapFree(p);
+}
+
+void *__wrap_chCoreAllocAlignedWithOffset(size_t size, unsigned align,
+                                          size_t offset) {
+  void *p = __real_chCoreAllocAlignedWithOffset(size, align, offset);
+
+  chSysLock();
+  heap_allocated(__builtin_return_address(0), HEAP_CORE, p, size);
+  chSysUnlock();
+  return p;
+}
+
+void *__wrap_chCoreAllocAlignedWithOffsetI(size_t size, unsigned align,
+                                           size_t offset) {
+  void *p = __real_chCoreAllocAlignedWithOffsetI(size, align, offset);
+
+  heap_allocated(__builtin_return_address(0), HEAP_CORE, p, size);
+  return p;
+}
+
+void *__wrap_mem_malloc(mem_size_t size) {
+  void *p = __real_mem_malloc(size);
+
+  chSysLock();
+  heap_allocated(__builtin_return_address(0), HEAP_LWIP, p, size);
+  chSysUnlock();
+  return p;
+}
+
+void __wrap_mem_free(void *mem) {
+  chSysLock();
+  heap_freed(mem);
+  chSysUnlock();
+  __real_mem_free(mem);
+}
+
+/* Shrinks in place, the block stays charged to its allocation site.*/
+void *__wrap_mem_trim(void *mem, mem_size_t size) {
+  void *p = __real_mem_trim(mem, size);
+
+  chSysLock();
+  for (int i = 0; i < HEAP_BLOCKS; i++) {
+    if (mem != NULL && heap_blocks[i].p == mem && heap_blocks[i].size > size) {
+      heap_sites[heap_blocks[i].site].live -= heap_blocks[i].size - size;
+      heap_blocks[i].size = size;
+      break;
+    }
+  }
+  chSysUnlock();
+  return p;
+}
+
+/**
+ * @brief Copies the call site statistics, optionally clearing them.
+ * @note  A reset keeps the live bytes, the blocks are still allocated.
+ */
+void heap_read(heap_stats_t *stats, bool reset) {
+  chSysLock();
+  stats->sites_count = heap_sites_count;
+  memcpy(stats->sites, heap_sites, sizeof(stats->sites));
+  stats->dropped = heap_overflow;
+  stats->untracked = heap_untracked;
+  if (reset) {
+    for (int i = 0; i < heap_sites_count; i++) {
+      heap_sites[i].count = 0;
+      heap_sites[i].bytes = 0;
+      heap_sites[i].peak = heap_sites[i].live;
+      heap_sites[i].failed = 0;
+    }
+    heap_overflow = 0;
+    heap_untracked = 0;
+  }
+  chSysUnlock();
+}
+#endif /* HEAP_PROFILE */
+
+/**
+ * @brief Fragmentation of the default kernel heap in permille, the share
+ *        of free memory outside the largest free block.
+ */
+uint32_t heap_fragmentation(size_t *free, size_t *largest) {
+  (void)chHeapStatus(NULL, free, largest);
+  if (*free == 0) {
+    return 0;
+  }
+  return (uint32_t)(1000 - (uint64_t)*largest * 1000 / *free);
+}
+
+/**
+ * @brief Shell command, "allocs [reset]" prints the allocations by call
+ *        site, resolve the addresses with addr2line.
+ */
+void cmd_allocs(BaseSequentialStream *chp, int argc, char *argv[]) {
+  bool reset = argc == 1 && strcmp(argv[0], "reset") == 0;
+  size_t free, largest;
+  uint32_t fragmentation;
+
+  if (argc > 1 || (argc == 1 && !reset)) {
+    chprintf(chp, "Usage: allocs [reset]" SHELL_NEWLINE_STR);
+    return;
+  }
+
+  fragmentation = heap_fragmentation(&free, &largest);
+  chprintf(chp, "heap free %u largest %u fragmentation %lu.%lu%%"
+                SHELL_NEWLINE_STR, free, largest,
+           fragmentation / 10, fragmentation % 10);
+#if !HEAP_PROFILE
+  chprintf(chp, "Build with USE_HEAP_PROFILE=yes" SHELL_NEWLINE_STR);
+#else
+  static const char *kinds[] = {"heap", "core", "lwip"};
+  heap_stats_t *stats = &heap_snapshot;
+
+  heap_read(stats, reset);
+  chprintf(chp, "site       kind    count    bytes     live     peak failed"
+                SHELL_NEWLINE_STR);
+  for (int i = 0; i < stats->sites_count; i++) {
+    heap_site_t *hs = &stats->sites[i];
+    chprintf(chp, "0x%08lx %-4s %8lu %8lu %8lu %8lu %6lu" SHELL_NEWLINE_STR,
+             (uint32_t)hs->site, kinds[hs->kind], hs->count, hs->bytes,
+             hs->live, hs->peak, hs->failed);
+  }
+  if (stats->dropped > 0) {
+    chprintf(chp, "%lu allocations from untracked sites" SHELL_NEWLINE_STR,
+             stats->dropped);
+  }
+  if (stats->untracked > 0) {
+    chprintf(chp, "%lu untracked blocks" SHELL_NEWLINE_STR, stats->untracked);
+  }
+#endif
+}
+
+/** @} */
@@ -0,0 +1,90 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file heap.h
+ * @brief Allocation profiler macros and structures.
+ * @addtogroup PROF_HEAP
+ * @{
+ */
+
+#ifndef HEAP_H
+#define HEAP_H
+
+/**
+ * @brief Set by the USE_HEAP_PROFILE=yes build, which also wraps the
+ *        allocators at link time.
+ */
+#ifndef HEAP_PROFILE
+#define HEAP_PROFILE            FALSE
+#endif
+
+/**
+ * @brief Call sites tracked, later ones are only counted as dropped.
+ */
+#ifndef HEAP_SITES
+#define HEAP_SITES              32
+#endif
+
+/**
+ * @brief Live blocks tracked, the live bytes skip the ones past it.
+ */
+#ifndef HEAP_BLOCKS
+#define HEAP_BLOCKS             128
+#endif
+
+typedef enum {
+  HEAP_CHIBIOS,
+  HEAP_CORE,
+  HEAP_LWIP
+} heap_kind_t;
+
+/**
+ * @brief Allocations made from one call site, sizes in bytes.
+ * @details Core memory is never freed, its live bytes only grow.
+ */
+typedef struct heap_site {
+  const void *site;
+  heap_kind_t kind;
+  uint32_t count;
+  uint32_t bytes;
+  uint32_t live;
+  uint32_t peak;
+  uint32_t failed;
+} heap_site_t;
+
+typedef struct heap_stats {
+  int sites_count;
+  heap_site_t sites[HEAP_SITES];
+  uint32_t dropped;
+  uint32_t untracked;
+} heap_stats_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#if HEAP_PROFILE
+  void heap_read(heap_stats_t *stats, bool reset);
+#endif
+  uint32_t heap_fragmentation(size_t *free, size_t *largest);
+  void cmd_allocs(BaseSequentialStream *chp, int argc, char *argv[]);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HEAP_H */
+
+/** @} */
@@ -0,0 +1,202 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file inversion.c
+ * @brief Priority inversion detector code.
+ * @details Runs in the context switch hook. A blocked thread that is
+ *          woken by a lower priority thread preempts it at once, so the
+ *          outgoing thread of that switch is taken as the server of the
+ *          wait and remembered for the next one. When the waiter blocks
+ *          again, the time its server has spent ready but preempted is
+ *          marked; when the same server wakes it, the difference is the
+ *          time the server could not run on the waiter's behalf. It is an
+ *          inversion if the thread that last preempted the server is below
+ *          the waiter.
+ *          Only waits on synchronization objects are tracked, sleeps and
+ *          suspensions have no server. Wakeups from interrupts are
+ *          attributed to the interrupted thread, a wrong server is
+ *          replaced at its next wakeup, the idle thread is never one.
+ * @addtogroup PROF_INVERSION
+ * @{
+ */
+
+#include <string.h>
+
+#include "ch.h"
+#include "hal.h"
+
+#include "chprintf.h"
+#include "shell.h"
+
+#include "prof.h"
+#include "cpu.h"
+#include "inversion.h"
+
+static inversion_stats_t inversion_stats;
+
+static uint32_t inversion_head;
+
+static inversion_stats_t inversion_snapshot;
+
+/* Cycles spent ready but not running, the current interval included.*/
+static uint64_t inversion_ready(const thread_t *tp, uint32_t now) {
+  return tp->inv_ready + (tp->inv_preempted ? now - tp->inv_since : 0);
+}
+
+static void inversion_record(thread_t *waiter, thread_t *server,
+                             uint32_t now) {
+  const thread_t *preemptor = server->inv_preemptor;
+  uint32_t inverted = (uint32_t)(server->inv_ready - waiter->inv_mark);
+  inversion_event_t *event;
+
+  if (inverted == 0 || preemptor == NULL ||
+      preemptor->prio >= waiter->prio) {
+    return;
+  }
+
+  inversion_stats.count++;
+  inversion_stats.inverted += inverted;
+  if (inverted > inversion_stats.max) {
+    inversion_stats.max = inverted;
+  }
+  event = &inversion_stats.events[inversion_head++ & (INVERSION_EVENTS - 1)];
+  if (inversion_stats.events_count < INVERSION_EVENTS) {
+    inversion_stats.events_count++;
+  }
+  event->time = chVTGetSystemTimeX();
+  event->object = waiter->inv_object;
+  event->waiter = waiter->name;
+  event->server = server->name;
+  event->preemptor = preemptor->name;
+  event->waiter_prio = waiter->prio;
+  event->server_prio = server->prio;
+  event->preemptor_prio = preemptor->prio;
+  event->blocked = now - waiter->inv_block;
+  event->inverted = inverted;
+}
+
+/* States where another thread releases the waiter.*/
+static bool inversion_waiting(const thread_t *tp) {
+  switch (tp->state) {
+  case CH_STATE_QUEUED:
+  case CH_STATE_WTSEM:
+  case CH_STATE_WTMTX:
+  case CH_STATE_WTCOND:
+  case CH_STATE_WTOREVT:
+  case CH_STATE_WTANDEVT:
+  case CH_STATE_SNDMSGQ:
+  case CH_STATE_SNDMSG:
+  case CH_STATE_WTMSG:
+    return true;
+  default:
+    return false;
+  }
+}
+
+/**
+ * @brief Context switch hook, called in the kernel critical zone.
+ */
+void inversion_switch(struct ch_thread *ntp, struct ch_thread *otp) {
+  uint32_t now = CPU_CYCLES();
+
+  if (ntp->inv_preempted) {
+    ntp->inv_ready += now - ntp->inv_since;
+    ntp->inv_preempted = false;
+  } else if (ntp->inv_block != 0 && otp->state == CH_STATE_READY) {
+    /* Woken, otp is the waker and has run up to now.*/
+    if (otp == ntp->inv_server) {
+      if (otp->prio < ntp->prio) {
+        inversion_record(ntp, otp, now);
+      }
+    } else if (otp->prio > IDLEPRIO) {
+      ntp->inv_server = otp;
+    }
+  }
+  ntp->inv_block = 0;
+
+  if (otp->state == CH_STATE_READY) {
+    otp->inv_preempted = true;
+    otp->inv_since = now;
+    otp->inv_preemptor = ntp;
+  } else if (inversion_waiting(otp)) {
+    otp->inv_block = now | 1;
+    otp->inv_object = otp->u.wtobjp;
+    if (otp->inv_server != NULL) {
+      otp->inv_mark = inversion_ready(otp->inv_server, now);
+    }
+  }
+}
+
+/**
+ * @brief Copies the counters and recent inversions, oldest first,
+ *        optionally clearing them.
+ */
+void inversion_read(inversion_stats_t *stats, bool reset) {
+  int first;
+
+  chSysLock();
+  stats->count = inversion_stats.count;
+  stats->inverted = inversion_stats.inverted;
+  stats->max = inversion_stats.max;
+  stats->events_count = inversion_stats.events_count;
+  first = (int)(inversion_head - inversion_stats.events_count);
+  for (int i = 0; i < stats->events_count; i++) {
+    stats->events[i] =
+        inversion_stats.events[(first + i) & (INVERSION_EVENTS - 1)];
+  }
+  if (reset) {
+    memset(&inversion_stats, 0, sizeof(inversion_stats));
+  }
+  chSysUnlock();
+}
+
+static uint32_t inversion_us(uint32_t cycles) {
+  return cycles / (CPU_CYCLES_HZ / 1000000);
+}
+
+/**
+ * @brief Shell command, "inversions [reset]" prints the recent inversions
+ *        as waiter > server < preemptor chains, times in us.
+ */
+void cmd_inversions(BaseSequentialStream *chp, int argc, char *argv[]) {
+  inversion_stats_t *stats = &inversion_snapshot;
+  bool reset = argc == 1 && strcmp(argv[0], "reset") == 0;
+
+  if (argc > 1 || (argc == 1 && !reset)) {
+    chprintf(chp, "Usage: inversions [reset]" SHELL_NEWLINE_STR);
+    return;
+  }
+
+  inversion_read(stats, reset);
+  chprintf(chp, "%lu inversions, %lu us total, %lu us max" SHELL_NEWLINE_STR,
+           stats->count,
+           (uint32_t)(stats->inverted / (CPU_CYCLES_HZ / 1000000)),
+           inversion_us(stats->max));
+  for (int i = 0; i < stats->events_count; i++) {
+    inversion_event_t *event = &stats->events[i];
+    chprintf(chp, "%8lu ms %s(%u) > %s(%u) < %s(%u) blocked %lu us"
+                  " inverted %lu us" SHELL_NEWLINE_STR,
+             (uint32_t)TIME_I2MS(event->time),
+             event->waiter ? event->waiter : "?", event->waiter_prio,
+             event->server ? event->server : "?", event->server_prio,
+             event->preemptor ? event->preemptor : "?",
+             event->preemptor_prio,
+             inversion_us(event->blocked), inversion_us(event->inverted));
+  }
+}
+
+/** @} */
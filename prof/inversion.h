@@ -0,0 +1,72 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file inversion.h
+ * @brief Priority inversion detector macros and structures.
+ * @addtogroup PROF_INVERSION
+ * @{
+ */
+
+#ifndef INVERSION_H
+#define INVERSION_H
+
+/**
+ * @brief Most recent inversions kept, a power of two.
+ */
+#ifndef INVERSION_EVENTS
+#define INVERSION_EVENTS        16
+#endif
+
+/**
+ * @brief One inversion, a blocked thread waited on a lower priority
+ *        server that was itself preempted by a thread below the waiter.
+ * @details Times are CPU cycles, @p inverted is the part of @p blocked
+ *          the server spent ready but preempted.
+ */
+typedef struct inversion_event {
+  systime_t time;
+  const void *object;
+  const char *waiter;
+  const char *server;
+  const char *preemptor;
+  tprio_t waiter_prio;
+  tprio_t server_prio;
+  tprio_t preemptor_prio;
+  uint32_t blocked;
+  uint32_t inverted;
+} inversion_event_t;
+
+typedef struct inversion_stats {
+  uint32_t count;
+  uint64_t inverted;
+  uint32_t max;
+  int events_count;
+  inversion_event_t events[INVERSION_EVENTS];
+} inversion_stats_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void inversion_read(inversion_stats_t *stats, bool reset);
+  void cmd_inversions(BaseSequentialStream *chp, int argc, char *argv[]);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INVERSION_H */
+
+/** @} */
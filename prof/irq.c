@@ -0,0 +1,224 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file irq.c
+ * @brief Interrupt duration and latency histograms code.
+ * @details The ISR prologue and epilogue hooks time every kernel aware
+ *          interrupt. A vector never preempts itself, so each slot has a
+ *          single writer and is updated without atomics, readers copy and
+ *          reset it under the kernel lock.
+ *          Latency needs the time the interrupt was raised, which only a
+ *          timer knows. The probe timer restarts its counter when it fires,
+ *          the counter read in its callback is how late it was served.
+ * @addtogroup PROF_IRQ
+ * @{
+ */
+
+#include <string.h>
+
+#include "ch.h"
+#include "hal.h"
+
+#include "chprintf.h"
+#include "shell.h"
+
+#include "metrics.h"
+#include "prof.h"
+#include "cpu.h"
+#include "irq.h"
+
+typedef struct irq_frame {
+  uint32_t start;
+  uint32_t nested;
+} irq_frame_t;
+
+static irq_stats_t irq_slots[IRQ_SLOTS];
+
+static uint8_t irq_map[IRQ_VECTORS];
+
+static uint32_t irq_count;
+
+static irq_frame_t irq_stack[IRQ_NESTING];
+
+static int irq_depth;
+
+static irq_stats_t irq_snapshot;
+
+static inline uint32_t irq_vector(void) {
+  return SCB->ICSR & SCB_ICSR_VECTACTIVE_Msk;
+}
+
+/* Slot of the active vector, NULL once all slots are taken.*/
+static irq_stats_t *irq_slot(void) {
+  uint32_t vector = irq_vector();
+  uint32_t slot;
+
+  if (vector >= IRQ_VECTORS) {
+    return NULL;
+  }
+  slot = irq_map[vector];
+  if (slot == 0) {
+    if (irq_count >= IRQ_SLOTS) {
+      return NULL;
+    }
+    slot = ++irq_count;
+    irq_slots[slot - 1].vector = (uint16_t)vector;
+    irq_map[vector] = (uint8_t)slot;
+  }
+  return &irq_slots[slot - 1];
+}
+
+static inline void irq_record(histogram_t *histogram, uint32_t value) {
+  histogram->buckets[histogram_index(value)]++;
+  histogram->count++;
+  histogram->sum += value;
+  if (value > histogram->max) {
+    histogram->max = value;
+  }
+}
+
+/**
+ * @brief ISR enter hook.
+ */
+void irq_enter(void) {
+  port_lock_from_isr();
+  if (irq_depth < IRQ_NESTING) {
+    irq_stack[irq_depth].start = CPU_CYCLES();
+    irq_stack[irq_depth].nested = 0;
+  }
+  irq_depth++;
+  port_unlock_from_isr();
+}
+
+/**
+ * @brief ISR exit hook.
+ */
+void irq_leave(void) {
+  irq_stats_t *stats;
+  uint32_t elapsed;
+
+  port_lock_from_isr();
+  irq_depth--;
+  if (irq_depth < IRQ_NESTING) {
+    elapsed = CPU_CYCLES() - irq_stack[irq_depth].start;
+    if (irq_depth > 0) {
+      irq_stack[irq_depth - 1].nested += elapsed;
+    }
+    stats = irq_slot();
+    if (stats != NULL) {
+      irq_record(&stats->duration, elapsed - irq_stack[irq_depth].nested);
+    }
+  }
+  port_unlock_from_isr();
+}
+
+/**
+ * @brief Records the entry latency of the active vector.
+ * @note  Called from an ISR that knows when its interrupt was raised.
+ */
+void irq_latency(uint32_t cycles) {
+  irq_stats_t *stats;
+
+  port_lock_from_isr();
+  stats = irq_slot();
+  if (stats != NULL) {
+    irq_record(&stats->latency, cycles);
+  }
+  port_unlock_from_isr();
+}
+
+#if IRQ_PROBE && HAL_USE_GPT
+static void irq_probe_cb(GPTDriver *gptp) {
+  /* The counter restarted from zero when the interrupt was raised.*/
+  irq_latency(gptp->tim->CNT * (CPU_CYCLES_HZ / IRQ_PROBE_FREQUENCY));
+}
+
+static const GPTConfig irq_probe_cfg = {
+  .frequency = IRQ_PROBE_FREQUENCY,
+  .callback = irq_probe_cb,
+  .cr2 = 0,
+  .dier = 0,
+};
+#endif
+
+/**
+ * @brief Starts the latency probe if enabled.
+ */
+void irq_probe_start(void) {
+#if IRQ_PROBE && HAL_USE_GPT
+  gptStart(&IRQ_PROBE_DRIVER, &irq_probe_cfg);
+  gptStartContinuous(&IRQ_PROBE_DRIVER, IRQ_PROBE_INTERVAL);
+#endif
+}
+
+/**
+ * @brief Copies the histograms of @p slot, optionally clearing them.
+ * @return false past the last slot in use.
+ */
+bool irq_read(int slot, irq_stats_t *stats, bool reset) {
+  bool used;
+
+  chSysLock();
+  used = slot < (int)irq_count;
+  if (used) {
+    memcpy(stats, &irq_slots[slot], sizeof(*stats));
+    if (reset) {
+      memset(&irq_slots[slot].duration, 0, sizeof(histogram_t));
+      memset(&irq_slots[slot].latency, 0, sizeof(histogram_t));
+    }
+  }
+  chSysUnlock();
+  return used;
+}
+
+static uint32_t irq_ns(uint32_t cycles) {
+  return (uint32_t)((uint64_t)cycles * 1000 / (CPU_CYCLES_HZ / 1000000));
+}
+
+static void irq_print(BaseSequentialStream *chp, const histogram_t *h) {
+  static const uint32_t permilles[] = {500, 900, 990};
+
+  for (int i = 0; i < 3; i++) {
+    chprintf(chp, " %7lu", irq_ns(histogram_quantile(h, permilles[i])));
+  }
+  chprintf(chp, " %7lu", irq_ns(h->max));
+}
+
+/**
+ * @brief Shell command, "irq [reset]" prints the duration (d) and latency
+ *        (l) quantiles in ns of each vector, then optionally clears them.
+ */
+void cmd_irq(BaseSequentialStream *chp, int argc, char *argv[]) {
+  bool reset = argc == 1 && strcmp(argv[0], "reset") == 0;
+
+  if (argc > 1 || (argc == 1 && !reset)) {
+    chprintf(chp, "Usage: irq [reset]" SHELL_NEWLINE_STR);
+    return;
+  }
+
+  chprintf(chp, "vector     count   d.p50   d.p90   d.p99   d.max"
+                "   l.p50   l.p90   l.p99   l.max" SHELL_NEWLINE_STR);
+  for (int i = 0; irq_read(i, &irq_snapshot, reset); i++) {
+    chprintf(chp, "%6u %9lu", irq_snapshot.vector,
+             irq_snapshot.duration.count);
+    irq_print(chp, &irq_snapshot.duration);
+    irq_print(chp, &irq_snapshot.latency);
+    chprintf(chp, SHELL_NEWLINE_STR);
+  }
+}
+
+/** @} */
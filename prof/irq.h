@@ -0,0 +1,117 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file irq.h
+ * @brief Interrupt duration and latency histograms macros and structures.
+ * @addtogroup PROF_IRQ
+ * @{
+ */
+
+#ifndef IRQ_H
+#define IRQ_H
+
+/**
+ * @brief Vectors tracked, slots are taken in the order vectors first fire.
+ */
+#ifndef IRQ_SLOTS
+#define IRQ_SLOTS               8
+#endif
+
+/**
+ * @brief Size of the vector to slot map, covers VECTACTIVE values.
+ */
+#ifndef IRQ_VECTORS
+#define IRQ_VECTORS             128
+#endif
+
+/**
+ * @brief Deepest interrupt nesting, one level per priority.
+ */
+#ifndef IRQ_NESTING
+#define IRQ_NESTING             16
+#endif
+
+/**
+ * @brief Latency probe, a GPT timer interrupt at the priority of the
+ *        Ethernet MAC that measures how late it is served.
+ */
+#ifndef IRQ_PROBE
+#define IRQ_PROBE               TRUE
+#endif
+
+/**
+ * @brief Probe timer, 32 bits wide so that it counts at the timer clock
+ *        for a low rate. TIM2 is the system tick.
+ */
+#ifndef IRQ_PROBE_DRIVER
+#define IRQ_PROBE_DRIVER        GPTD5
+#ifndef IRQ_PROBE_NUMBER
+#define IRQ_PROBE_NUMBER        STM32_TIM5_NUMBER
+#endif
+#endif
+
+/**
+ * @brief IRQ number of the probe timer, the trace leaves it out.
+ * @note  A board that changes IRQ_PROBE_DRIVER must also set it.
+ */
+#if IRQ_PROBE && !defined(IRQ_PROBE_NUMBER)
+#error "IRQ_PROBE_NUMBER must be defined along with IRQ_PROBE_DRIVER"
+#endif
+
+/**
+ * @brief Probe timer clock, the timer clock itself for cycle resolution.
+ */
+#ifndef IRQ_PROBE_FREQUENCY
+#define IRQ_PROBE_FREQUENCY     STM32_TIMCLK1
+#endif
+
+/**
+ * @brief Probe rate, each probe is one more interrupt at the MAC priority.
+ */
+#ifndef IRQ_PROBE_HZ
+#define IRQ_PROBE_HZ            50
+#endif
+
+/**
+ * @brief Probe period in timer ticks.
+ */
+#define IRQ_PROBE_INTERVAL      (IRQ_PROBE_FREQUENCY / IRQ_PROBE_HZ)
+
+/**
+ * @brief Histograms of one vector, values are CPU cycles.
+ * @details Durations exclude the time spent in nested interrupts.
+ */
+typedef struct irq_stats {
+  uint16_t vector;
+  histogram_t duration;
+  histogram_t latency;
+} irq_stats_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void irq_latency(uint32_t cycles);
+  void irq_probe_start(void);
+  bool irq_read(int slot, irq_stats_t *stats, bool reset);
+  void cmd_irq(BaseSequentialStream *chp, int argc, char *argv[]);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IRQ_H */
+
+/** @} */
@@ -0,0 +1,109 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file load.c
+ * @brief System CPU load code.
+ * @details The idle hooks add up the cycles spent in the idle thread, the
+ *          load of a window is the share of its cycles that were not idle.
+ *          Interrupts served while idle count as idle time. The 10 s and
+ *          60 s loads are exponentially decaying averages of the 1 s one.
+ * @addtogroup PROF_LOAD
+ * @{
+ */
+
+#include "ch.h"
+#include "hal.h"
+
+#include "prof.h"
+#include "cpu.h"
+#include "load.h"
+
+static uint32_t load_idle_start;
+
+static uint64_t load_idle;
+
+static uint64_t load_idle_mark;
+
+static uint32_t load_cycles_mark;
+
+static systime_t load_time;
+
+/* Loads as 16.16 fractions, written by the window owner only.*/
+static volatile uint32_t load_values[LOAD_WINDOWS];
+
+static uint32_t load_decay(uint32_t average, uint32_t load, int32_t period) {
+  return (uint32_t)((int32_t)average + ((int32_t)load - (int32_t)average) /
+                    period);
+}
+
+/**
+ * @brief Idle thread enter hook, called in the kernel critical zone.
+ */
+void load_idle_enter(void) {
+  load_idle_start = CPU_CYCLES();
+}
+
+/**
+ * @brief Idle thread leave hook, called in the kernel critical zone.
+ */
+void load_idle_leave(void) {
+  load_idle += CPU_CYCLES() - load_idle_start;
+}
+
+/**
+ * @brief Closes the load window if LOAD_WINDOW_MS elapsed.
+ * @return true if the loads were updated.
+ */
+bool load_window(void) {
+  systime_t now = chVTGetSystemTimeX();
+  uint32_t cycles, elapsed, busy;
+  uint64_t idle;
+
+  if (chTimeDiffX(load_time, now) < TIME_MS2I(LOAD_WINDOW_MS)) {
+    return false;
+  }
+  load_time = now;
+
+  /* The caller is running, no idle interval is open.*/
+  chSysLock();
+  idle = load_idle - load_idle_mark;
+  load_idle_mark = load_idle;
+  cycles = CPU_CYCLES();
+  chSysUnlock();
+  elapsed = cycles - load_cycles_mark;
+  load_cycles_mark = cycles;
+  if (elapsed == 0) {
+    return false;
+  }
+
+  busy = idle < elapsed ? elapsed - (uint32_t)idle : 0;
+  load_values[0] = (uint32_t)(((uint64_t)busy << 16) / elapsed);
+  load_values[1] = load_decay(load_values[1], load_values[0], 10);
+  load_values[2] = load_decay(load_values[2], load_values[0], 60);
+  return true;
+}
+
+/**
+ * @brief Copies the 1 s, 10 s and 60 s loads in permille.
+ */
+void load_read(uint16_t permille[LOAD_WINDOWS]) {
+  for (int i = 0; i < LOAD_WINDOWS; i++) {
+    permille[i] = (uint16_t)CPU_PERMILLE(load_values[i]);
+  }
+}
+
+/** @} */
@@ -0,0 +1,50 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file load.h
+ * @brief System CPU load macros and structures.
+ * @addtogroup PROF_LOAD
+ * @{
+ */
+
+#ifndef LOAD_H
+#define LOAD_H
+
+/**
+ * @brief Shortest interval between two load windows.
+ */
+#ifndef LOAD_WINDOW_MS
+#define LOAD_WINDOW_MS          1000
+#endif
+
+/**
+ * @brief Loads kept, 1 s and decaying 10 s and 60 s.
+ */
+#define LOAD_WINDOWS            3
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  bool load_window(void);
+  void load_read(uint16_t permille[LOAD_WINDOWS]);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LOAD_H */
+
+/** @} */
@@ -0,0 +1,362 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file locks.c
+ * @brief Lock contention profiler code.
+ * @details The USE_LOCKS_PROFILE=yes build links every call to the kernel
+ *          mutex, semaphore and mailbox post primitives through the
+ *          __wrap_ functions below, lwIP's sys_arch included. A wrapper
+ *          notes whether the object was busy, calls the real primitive and
+ *          records the wait, the hold time and the waiting thread under the
+ *          kernel lock. The blocking variants go through the S-class ones
+ *          with the lock taken, as the kernel does. Mailbox fetches are not
+ *          wrapped, an empty mailbox is a thread waiting for work rather
+ *          than contention. --wrap only redirects calls between object
+ *          files: chMtxLock() calling chMtxLockS() in chmtx.c, or chSemWait()
+ *          calling chSemWaitTimeoutS() in chsem.c, uses the real symbol and
+ *          is not seen. A wait is counted once by the outer wrapper, and
+ *          kernel code in those files that takes a lock is not profiled.
+ *          Without the build option only the report is compiled and it is
+ *          always empty.
+ * @addtogroup PROF_LOCKS
+ * @{
+ */
+
+#include <string.h>
+
+#include "ch.h"
+#include "hal.h"
+
+#include "chprintf.h"
+#include "shell.h"
+
+#include "metrics.h"
+#include "cpu.h"
+#include "locks.h"
+
+#if LOCKS_PROFILE
+static locks_object_t locks_objects[LOCKS_OBJECTS];
+
+static int locks_count;
+
+static uint32_t locks_overflow;
+
+static locks_object_t locks_snapshot;
+
+static inline void locks_record(histogram_t *histogram, uint32_t value) {
+  histogram->buckets[histogram_index(value)]++;
+  histogram->count++;
+  histogram->sum += value;
+  if (value > histogram->max) {
+    histogram->max = value;
+  }
+}
+
+/* Called in the kernel critical zone.*/
+static locks_object_t *locks_find(const void *object, locks_kind_t kind) {
+  locks_object_t *lock;
+
+  for (int i = 0; i < locks_count; i++) {
+    if (locks_objects[i].object == object) {
+      return &locks_objects[i];
+    }
+  }
+  if (locks_count >= LOCKS_OBJECTS) {
+    locks_overflow++;
+    return NULL;
+  }
+  lock = &locks_objects[locks_count++];
+  lock->object = object;
+  lock->kind = kind;
+  return lock;
+}
+
+/* Called in the kernel critical zone after the real primitive returned.*/
+static void locks_acquired(const void *object, locks_kind_t kind,
+                           bool busy, uint32_t start, bool acquired) {
+  locks_object_t *lock = locks_find(object, kind);
+  uint32_t now = CPU_CYCLES();
+
+  if (lock == NULL) {
+    return;
+  }
+  lock->kind = kind;
+  lock->acquires++;
+  if (busy) {
+    const char *name = currp->name;
+    int i;
+
+    lock->contended++;
+    lock->waited += now - start;
+    locks_record(&lock->wait, now - start);
+    for (i = 0; i < LOCKS_CONTENDERS; i++) {
+      if (lock->contenders[i].name == name ||
+          lock->contenders[i].count == 0) {
+        lock->contenders[i].name = name;
+        lock->contenders[i].count++;
+        break;
+      }
+    }
+  }
+  if (acquired && kind != LOCKS_MAILBOX) {
+    lock->holder = currp;
+    lock->held = now;
+  }
+}
+
+/* Called in the kernel critical zone before the real primitive.*/
+static void locks_released(const void *object, locks_kind_t kind) {
+  locks_object_t *lock = locks_find(object, kind);
+
+  if (lock == NULL || lock->holder == NULL) {
+    return;
+  }
+  /* A semaphore signalled by another thread is an event, not a lock.*/
+  if (lock->holder == currp) {
+    locks_record(&lock->hold, CPU_CYCLES() - lock->held);
+  }
+  lock->holder = NULL;
+}
+
+/**
+ * @brief Names a lock object in the reports.
+ */
+void locks_name(const void *object, const char *name) {
+  chSysLock();
+  locks_object_t *lock = locks_find(object, LOCKS_MUTEX);
+  if (lock != NULL) {
+    lock->name = name;
+  }
+  chSysUnlock();
+}
+
+void __real_chMtxLock(mutex_t *mp);
+void __real_chMtxLockS(mutex_t *mp);
+void __real_chMtxUnlock(mutex_t *mp);
+void __real_chMtxUnlockS(mutex_t *mp);
+msg_t __real_chSemWaitTimeoutS(semaphore_t *sp, sysinterval_t timeout);
+void __real_chSemSignal(semaphore_t *sp);
+void __real_chSemSignalI(semaphore_t *sp);
+msg_t __real_chMBPostTimeoutS(mailbox_t *mbp, msg_t msg,
+                              sysinterval_t timeout);
+
+void __wrap_chMtxLock(mutex_t *mp) {
+  uint32_t start = CPU_CYCLES();
+  bool busy = mp->owner != NULL;
+
+  __real_chMtxLock(mp);
+  chSysLock();
+  locks_acquired(mp, LOCKS_MUTEX, busy, start, true);
+  chSysUnlock();
+}
+
+void __wrap_chMtxLockS(mutex_t *mp) {
+  uint32_t start = CPU_CYCLES();
+  bool busy = mp->owner != NULL;
+
+  __real_chMtxLockS(mp);
+  locks_acquired(mp, LOCKS_MUTEX, busy, start, true);
+}
+
+void __wrap_chMtxUnlock(mutex_t *mp) {
+  chSysLock();
+  locks_released(mp, LOCKS_MUTEX);
+  chSysUnlock();
+  __real_chMtxUnlock(mp);
+}
+
+void __wrap_chMtxUnlockS(mutex_t *mp) {
+  locks_released(mp, LOCKS_MUTEX);
+  __real_chMtxUnlockS(mp);
+}
+
+msg_t __wrap_chSemWaitTimeoutS(semaphore_t *sp, sysinterval_t timeout) {
+  uint32_t start = CPU_CYCLES();
+  bool busy = sp->cnt <= 0;
+  msg_t msg;
+
+  msg = __real_chSemWaitTimeoutS(sp, timeout);
+  locks_acquired(sp, LOCKS_SEMAPHORE, busy, start, msg == MSG_OK);
+  return msg;
+}
+
+msg_t __wrap_chSemWaitTimeout(semaphore_t *sp, sysinterval_t timeout) {
+  msg_t msg;
+
+  chSysLock();
+  msg = __wrap_chSemWaitTimeoutS(sp, timeout);
+  chSysUnlock();
+  return msg;
+}
+
+msg_t __wrap_chSemWait(semaphore_t *sp) {
+  return __wrap_chSemWaitTimeout(sp, TIME_INFINITE);
+}
+
+msg_t __wrap_chSemWaitS(semaphore_t *sp) {
+  return __wrap_chSemWaitTimeoutS(sp, TIME_INFINITE);
+}
+
+void __wrap_chSemSignal(semaphore_t *sp) {
+  chSysLock();
+  locks_released(sp, LOCKS_SEMAPHORE);
+  chSysUnlock();
+  __real_chSemSignal(sp);
+}
+
+void __wrap_chSemSignalI(semaphore_t *sp) {
+  locks_released(sp, LOCKS_SEMAPHORE);
+  __real_chSemSignalI(sp);
+}
+
+msg_t __wrap_chMBPostTimeoutS(mailbox_t *mbp, msg_t msg,
+                              sysinterval_t timeout) {
+  uint32_t start = CPU_CYCLES();
+  bool busy = chMBGetFreeCountI(mbp) == 0;
+  msg_t rdymsg;
+
+  rdymsg = __real_chMBPostTimeoutS(mbp, msg, timeout);
+  locks_acquired(mbp, LOCKS_MAILBOX, busy, start, rdymsg == MSG_OK);
+  return rdymsg;
+}
+
+msg_t __wrap_chMBPostTimeout(mailbox_t *mbp, msg_t msg,
+                             sysinterval_t timeout) {
+  msg_t rdymsg;
+
+  chSysLock();
+  rdymsg = __wrap_chMBPostTimeoutS(mbp, msg, timeout);
+  chSysUnlock();
+  return rdymsg;
+}
+/**
+ * @brief Fills @p order with the lock indexes, most waited on first.
+ * @return The number of locks.
+ */
+int locks_rank(int order[LOCKS_OBJECTS]) {
+  uint64_t waited[LOCKS_OBJECTS];
+  int count;
+
+  chSysLock();
+  count = locks_count;
+  for (int i = 0; i < count; i++) {
+    waited[i] = locks_objects[i].waited;
+  }
+  chSysUnlock();
+
+  for (int i = 0; i < count; i++) {
+    int j = i;
+    while (j > 0 && waited[order[j - 1]] < waited[i]) {
+      order[j] = order[j - 1];
+      j--;
+    }
+    order[j] = i;
+  }
+  return count;
+}
+
+/**
+ * @brief Copies the statistics of lock @p index, optionally clearing them.
+ * @note  Tracked objects and their names are kept across resets.
+ */
+bool locks_read(int index, locks_object_t *lock, bool reset) {
+  bool used;
+
+  chSysLock();
+  used = index < locks_count;
+  if (used) {
+    locks_object_t *src = &locks_objects[index];
+    memcpy(lock, src, sizeof(*lock));
+    if (reset) {
+      src->acquires = 0;
+      src->contended = 0;
+      src->waited = 0;
+      memset(src->contenders, 0, sizeof(src->contenders));
+      memset(&src->wait, 0, sizeof(src->wait));
+      memset(&src->hold, 0, sizeof(src->hold));
+    }
+  }
+  chSysUnlock();
+  return used;
+}
+
+/**
+ * @brief Acquisitions of objects past LOCKS_OBJECTS.
+ */
+uint32_t locks_dropped(void) {
+  return locks_overflow;
+}
+
+static uint32_t locks_us(uint32_t cycles) {
+  return cycles / (CPU_CYCLES_HZ / 1000000);
+}
+#endif /* LOCKS_PROFILE */
+
+/**
+ * @brief Shell command, "locks [reset]" prints the most contended locks,
+ *        wait and hold times in us.
+ */
+void cmd_locks(BaseSequentialStream *chp, int argc, char *argv[]) {
+  bool reset = argc == 1 && strcmp(argv[0], "reset") == 0;
+
+  if (argc > 1 || (argc == 1 && !reset)) {
+    chprintf(chp, "Usage: locks [reset]" SHELL_NEWLINE_STR);
+    return;
+  }
+
+#if !LOCKS_PROFILE
+  chprintf(chp, "Build with USE_LOCKS_PROFILE=yes" SHELL_NEWLINE_STR);
+#else
+  static const char *kinds[] = {"mutex", "sem", "mbox"};
+  int order[LOCKS_OBJECTS];
+  int count;
+
+  chprintf(chp, "lock               kind   acquires contended   waited"
+                "  w.p99  w.max  h.p99  h.max" SHELL_NEWLINE_STR);
+  count = locks_rank(order);
+  for (int i = 0; i < count; i++) {
+    locks_object_t *lock = &locks_snapshot;
+    if (!locks_read(order[i], lock, reset)) {
+      break;
+    }
+    if (lock->name != NULL) {
+      chprintf(chp, "%-18s", lock->name);
+    } else {
+      chprintf(chp, "0x%08lx        ", (uint32_t)lock->object);
+    }
+    chprintf(chp, " %-5s %9lu %9lu %8lu %6lu %6lu %6lu %6lu",
+             kinds[lock->kind], lock->acquires, lock->contended,
+             (uint32_t)(lock->waited / (CPU_CYCLES_HZ / 1000000)),
+             locks_us(histogram_quantile(&lock->wait, 990)),
+             locks_us(lock->wait.max),
+             locks_us(histogram_quantile(&lock->hold, 990)),
+             locks_us(lock->hold.max));
+    for (int j = 0; j < LOCKS_CONTENDERS && lock->contenders[j].count; j++) {
+      chprintf(chp, " %s:%lu",
+               lock->contenders[j].name ? lock->contenders[j].name : "?",
+               lock->contenders[j].count);
+    }
+    chprintf(chp, SHELL_NEWLINE_STR);
+  }
+  if (locks_overflow > 0) {
+    chprintf(chp, "%lu acquisitions of untracked locks" SHELL_NEWLINE_STR,
+             locks_overflow);
+  }
+#endif
+}
+
+/** @} */
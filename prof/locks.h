@@ -0,0 +1,100 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file locks.h
+ * @brief Lock contention profiler macros and structures.
+ * @addtogroup PROF_LOCKS
+ * @{
+ */
+
+#ifndef LOCKS_H
+#define LOCKS_H
+
+/**
+ * @brief Set by the USE_LOCKS_PROFILE=yes build, which also wraps the
+ *        kernel lock primitives at link time.
+ */
+#ifndef LOCKS_PROFILE
+#define LOCKS_PROFILE           FALSE
+#endif
+
+/**
+ * @brief Lock objects tracked, later ones are only counted as dropped.
+ */
+#ifndef LOCKS_OBJECTS
+#define LOCKS_OBJECTS           12
+#endif
+
+/**
+ * @brief Waiting threads remembered per lock.
+ */
+#ifndef LOCKS_CONTENDERS
+#define LOCKS_CONTENDERS        4
+#endif
+
+typedef enum {
+  LOCKS_MUTEX,
+  LOCKS_SEMAPHORE,
+  LOCKS_MAILBOX
+} locks_kind_t;
+
+typedef struct locks_contender {
+  const char *name;
+  uint32_t count;
+} locks_contender_t;
+
+/**
+ * @brief Statistics of one lock object, times are CPU cycles.
+ * @details @p wait only records the acquisitions that had to block. Hold
+ *          times are recorded when the thread that acquired the object
+ *          also releases it, mailbox posts have none.
+ */
+typedef struct locks_object {
+  const void *object;
+  const char *name;
+  locks_kind_t kind;
+  uint32_t acquires;
+  uint32_t contended;
+  uint64_t waited;
+  const void *holder;
+  uint32_t held;
+  locks_contender_t contenders[LOCKS_CONTENDERS];
+  histogram_t wait;
+  histogram_t hold;
+} locks_object_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#if LOCKS_PROFILE
+  void locks_name(const void *object, const char *name);
+  int locks_rank(int order[LOCKS_OBJECTS]);
+  bool locks_read(int index, locks_object_t *lock, bool reset);
+  uint32_t locks_dropped(void);
+#endif
+  void cmd_locks(BaseSequentialStream *chp, int argc, char *argv[]);
+#ifdef __cplusplus
+}
+#endif
+
+#if !LOCKS_PROFILE
+#define locks_name(object, name) ((void)(object), (void)(name))
+#endif
+
+#endif /* LOCKS_H */
+
+/** @} */
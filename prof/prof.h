@@ -0,0 +1,51 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file prof.h
+ * @brief Kernel hooks of the profiling modules.
+ * @details Included by chconf.h, only forward declarations can be used.
+ * @addtogroup PROF
+ * @{
+ */
+
+#ifndef PROF_H
+#define PROF_H
+
+#include <stdint.h>
+
+struct ch_thread;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void cpu_init(void);
+  void cpu_switch(struct ch_thread *ntp, struct ch_thread *otp);
+  void trace_switch(struct ch_thread *ntp);
+  void trace_irq_enter(void);
+  void trace_irq_leave(void);
+  void irq_enter(void);
+  void irq_leave(void);
+  void load_idle_enter(void);
+  void load_idle_leave(void);
+  void inversion_switch(struct ch_thread *ntp, struct ch_thread *otp);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PROF_H */
+
+/** @} */
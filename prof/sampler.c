@@ -0,0 +1,430 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file sampler.c
+ * @brief Sampling profiler code.
+ * @details A basic timer interrupts at SAMPLER_FREQUENCY and the handler
+ *          takes the interrupted PC from the exception frame on the thread
+ *          stack, the EXC_RETURN value tells which frame layout was
+ *          stacked, as in the port epilogue. Samples are counted per
+ *          distinct stack and thread in an open addressing table.
+ *          The USE_SAMPLER_UNWIND=yes build adds unwind tables and the
+ *          handler walks a few callers with the ARM EHABI compact unwind
+ *          instructions. Frame pointers would not help, GCC does not chain
+ *          the Thumb-2 frames. The walk only reads the interrupted thread
+ *          stack and stops at the first frame it cannot unwind.
+ *          The handler is masked by the kernel critical zones, their cost
+ *          is charged to the instruction that leaves them.
+ *          Export is the folded format of the flame graph tools, frames are
+ *          addresses to be resolved with addr2line, callers point into the
+ *          call instruction.
+ * @addtogroup PROF_SAMPLER
+ * @{
+ */
+
+#include <string.h>
+
+#include "ch.h"
+#include "hal.h"
+
+#include "chprintf.h"
+#include "shell.h"
+
+#include "metrics.h"
+#include "sampler.h"
+
+static sampler_stack_t sampler_stacks[SAMPLER_BUCKETS];
+
+static uint32_t sampler_samples;
+
+static uint32_t sampler_dropped;
+
+static sampler_stack_t sampler_snapshot;
+
+extern stkalign_t __main_thread_stack_end__;
+
+#if SAMPLER_UNWIND
+extern const uint32_t __exidx_start[], __exidx_end[];
+
+/**
+ * @brief Registers of the frame being unwound, bit n of @p valid is set
+ *        when rn is known.
+ */
+typedef struct sampler_regs {
+  uint32_t r[16];
+  uint32_t valid;
+  uint32_t low;
+  uint32_t high;
+} sampler_regs_t;
+
+/**
+ * @brief Unwind instruction reader.
+ */
+typedef struct sampler_ops {
+  const uint32_t *data;
+  int shift;
+  int words;
+} sampler_ops_t;
+
+static uint32_t sampler_prel31(const uint32_t *p) {
+  return (uint32_t)p + (uint32_t)((int32_t)(*p << 1) >> 1);
+}
+
+/* Index entry of the function containing pc, NULL outside the code.*/
+static const uint32_t *sampler_entry(uint32_t pc) {
+  int lo = 0, hi = (__exidx_end - __exidx_start) / 2 - 1;
+
+  if (hi < 0 || pc < sampler_prel31(&__exidx_start[0]) ||
+      pc >= (uint32_t)__exidx_start) {
+    return NULL;
+  }
+  while (lo < hi) {
+    int mid = (lo + hi + 1) / 2;
+    if (sampler_prel31(&__exidx_start[mid * 2]) <= pc) {
+      lo = mid;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  return &__exidx_start[lo * 2];
+}
+
+/* Returns "finish" past the last instruction.*/
+static uint8_t sampler_op(sampler_ops_t *ops) {
+  uint8_t op;
+
+  if (ops->shift < 0) {
+    if (ops->words == 0) {
+      return 0xb0;
+    }
+    ops->data++;
+    ops->words--;
+    ops->shift = 24;
+  }
+  op = (*ops->data >> ops->shift) & 0xff;
+  ops->shift -= 8;
+  return op;
+}
+
+static bool sampler_pop(sampler_regs_t *regs, uint32_t mask) {
+  uint32_t vsp = regs->r[13];
+
+  if (vsp < regs->low || vsp + 4 * __builtin_popcount(mask) > regs->high) {
+    return false;
+  }
+  for (int i = 0; i < 16; i++) {
+    if (mask & (1U << i)) {
+      regs->r[i] = *(const uint32_t *)vsp;
+      regs->valid |= 1U << i;
+      vsp += 4;
+    }
+  }
+  if ((mask & (1U << 13)) == 0) {
+    regs->r[13] = vsp;
+  }
+  return true;
+}
+
+/* Moves regs to the caller frame, false when it cannot.*/
+static bool sampler_unwind(sampler_regs_t *regs, uint32_t pc) {
+  const uint32_t *entry = sampler_entry(pc);
+  sampler_ops_t ops;
+  uint32_t *vsp = &regs->r[13];
+  uint32_t word, mask;
+  uint8_t op;
+
+  if (entry == NULL || entry[1] == 1) {
+    return false;
+  }
+  if (entry[1] & 0x80000000U) {
+    ops = (sampler_ops_t) {.data = &entry[1], .shift = 16, .words = 0};
+    word = entry[1];
+  } else {
+    ops.data = (const uint32_t *)sampler_prel31(&entry[1]);
+    word = *ops.data;
+    if ((word & 0x80000000U) == 0) {
+      return false;
+    }
+    ops.shift = (word & 0x0f000000U) ? 8 : 16;
+    ops.words = (word & 0x0f000000U) ? (word >> 16) & 0xff : 0;
+  }
+  /* Only the compact models, personality 0 to 2.*/
+  if (((word >> 24) & 0x0f) > 2) {
+    return false;
+  }
+
+  regs->valid &= ~(1U << 15);
+  for (int i = 0; i < 32; i++) {
+    op = sampler_op(&ops);
+    if ((op & 0xc0) == 0x00) {
+      *vsp += ((op & 0x3fU) << 2) + 4;
+    } else if ((op & 0xc0) == 0x40) {
+      *vsp -= ((op & 0x3fU) << 2) + 4;
+    } else if ((op & 0xf0) == 0x80) {
+      mask = ((op & 0x0fU) << 8) | sampler_op(&ops);
+      if (mask == 0 || !sampler_pop(regs, mask << 4)) {
+        return false;
+      }
+    } else if ((op & 0xf0) == 0x90) {
+      int n = op & 0x0f;
+      if (n == 13 || n == 15 || (regs->valid & (1U << n)) == 0) {
+        return false;
+      }
+      *vsp = regs->r[n];
+    } else if ((op & 0xf0) == 0xa0) {
+      mask = ((1U << ((op & 0x07) + 1)) - 1) << 4;
+      if (op & 0x08) {
+        mask |= 1U << 14;
+      }
+      if (!sampler_pop(regs, mask)) {
+        return false;
+      }
+    } else if (op == 0xb0) {
+      break;
+    } else if (op == 0xb1) {
+      mask = sampler_op(&ops);
+      if (mask == 0 || (mask & 0xf0) || !sampler_pop(regs, mask)) {
+        return false;
+      }
+    } else if (op == 0xb2) {
+      uint32_t value = 0;
+      int shift = 0;
+      do {
+        op = sampler_op(&ops);
+        value |= (op & 0x7fU) << shift;
+        shift += 7;
+      } while ((op & 0x80) && shift < 28);
+      *vsp += 0x204 + (value << 2);
+    } else if (op == 0xb3) {
+      *vsp += ((sampler_op(&ops) & 0x0fU) + 1) * 8 + 4;
+    } else if ((op & 0xf8) == 0xb8) {
+      *vsp += ((op & 0x07U) + 1) * 8 + 4;
+    } else if (op == 0xc8 || op == 0xc9) {
+      *vsp += ((sampler_op(&ops) & 0x0fU) + 1) * 8;
+    } else if ((op & 0xf8) == 0xd0) {
+      *vsp += ((op & 0x07U) + 1) * 8;
+    } else {
+      return false;
+    }
+  }
+  /* A frame that did not save the return address returns through lr.*/
+  if ((regs->valid & (1U << 15)) == 0) {
+    if ((regs->valid & (1U << 14)) == 0) {
+      return false;
+    }
+    regs->r[15] = regs->r[14];
+  }
+  return regs->r[13] != 0;
+}
+#endif /* SAMPLER_UNWIND */
+
+/* Called in the sampling interrupt, the table is only written there.*/
+static void sampler_record(const char *thread, const uint32_t *pcs) {
+  uint32_t hash = 2166136261U ^ (uint32_t)thread;
+
+  for (int i = 0; i < SAMPLER_DEPTH; i++) {
+    hash = (hash ^ pcs[i]) * 16777619U;
+  }
+  sampler_samples++;
+  for (int i = 0; i < SAMPLER_PROBES; i++) {
+    sampler_stack_t *stack = &sampler_stacks[(hash + i) &
+                                             (SAMPLER_BUCKETS - 1)];
+    if (stack->count == 0) {
+      stack->thread = thread;
+      memcpy(stack->pcs, pcs, sizeof(stack->pcs));
+    } else if (stack->thread != thread ||
+               memcmp(stack->pcs, pcs, sizeof(stack->pcs)) != 0) {
+      continue;
+    }
+    stack->count++;
+    return;
+  }
+  sampler_dropped++;
+}
+
+/* Called in the sampling interrupt with its EXC_RETURN value.*/
+static void sampler_sample(uint32_t exc_return) {
+  uint32_t pcs[SAMPLER_DEPTH] = {0};
+  const uint32_t *frame;
+
+  /* Returning to handler mode, another interrupt was sampled.*/
+  if ((exc_return & 0x0c) != 0x0c) {
+    sampler_record("irq", pcs);
+    return;
+  }
+  frame = (const uint32_t *)__get_PSP();
+  pcs[0] = frame[6] & ~1U;
+#if SAMPLER_UNWIND
+  {
+    thread_t *tp = currp;
+    sampler_regs_t regs = {
+      .r = {frame[0], frame[1], frame[2], frame[3],
+            [12] = frame[4], [14] = frame[5], [15] = frame[6]},
+      .valid = 0xf00f,
+      .low = (uint32_t)frame,
+      .high = tp == &ch.mainthread ? (uint32_t)&__main_thread_stack_end__
+                                   : (uint32_t)tp,
+    };
+
+    /* Basic or extended frame and the alignment padding.*/
+    regs.r[13] = (uint32_t)frame + ((exc_return & 0x10) ? 0x20 : 0x68) +
+                 ((frame[7] & (1U << 9)) ? 4 : 0);
+    for (int i = 1; i < SAMPLER_DEPTH; i++) {
+      uint32_t pc = regs.r[15] & ~1U;
+      uint32_t sp = regs.r[13];
+
+      if (!sampler_unwind(&regs, i == 1 ? pc : pc - 2)) {
+        break;
+      }
+      if ((regs.r[15] & ~1U) == pc && regs.r[13] == sp) {
+        break;
+      }
+      /* Into the call instruction, the return address may already be in
+         the next function.*/
+      pcs[i] = (regs.r[15] & ~1U) - 2;
+    }
+  }
+#endif
+  sampler_record(currp->name != NULL ? currp->name : "thread", pcs);
+}
+
+OSAL_IRQ_HANDLER(SAMPLER_HANDLER) {
+  uint32_t exc_return = (uint32_t)__builtin_return_address(0);
+
+  OSAL_IRQ_PROLOGUE();
+
+  SAMPLER_TIM->SR = 0;
+  sampler_sample(exc_return);
+
+  OSAL_IRQ_EPILOGUE();
+}
+
+/**
+ * @brief Starts sampling, called once from main().
+ */
+void sampler_start(void) {
+  SAMPLER_RCC_ENABLE();
+  SAMPLER_TIM->PSC = SAMPLER_CLOCK / 1000000 - 1;
+  SAMPLER_TIM->ARR = 1000000 / SAMPLER_FREQUENCY - 1;
+  SAMPLER_TIM->EGR = STM32_TIM_EGR_UG;
+  SAMPLER_TIM->SR = 0;
+  SAMPLER_TIM->DIER = STM32_TIM_DIER_UIE;
+  nvicEnableVector(SAMPLER_NUMBER, SAMPLER_IRQ_PRIORITY);
+  SAMPLER_TIM->CR1 = STM32_TIM_CR1_CEN;
+}
+
+/**
+ * @brief Samples taken and samples of stacks that found no bucket.
+ */
+void sampler_totals(uint32_t *samples, uint32_t *dropped) {
+  chSysLock();
+  *samples = sampler_samples;
+  *dropped = sampler_dropped;
+  chSysUnlock();
+}
+
+/* Copies bucket index, false when empty.*/
+static bool sampler_read(int index, sampler_stack_t *stack, bool reset) {
+  chSysLock();
+  memcpy(stack, &sampler_stacks[index], sizeof(*stack));
+  if (reset) {
+    sampler_stacks[index].count = 0;
+  }
+  chSysUnlock();
+  return stack->count > 0;
+}
+
+static void sampler_reset(void) {
+  chSysLock();
+  sampler_samples = 0;
+  sampler_dropped = 0;
+  chSysUnlock();
+}
+
+/* Formats the stack root first, the thread is the root frame.*/
+static void sampler_fold(const sampler_stack_t *stack, char *line,
+                         size_t size) {
+  size_t len = chsnprintf(line, size, "%s", stack->thread);
+
+  for (int i = SAMPLER_DEPTH - 1; i >= 0; i--) {
+    if (stack->pcs[i] != 0 && len < size) {
+      len += chsnprintf(line + len, size - len, ";0x%08lx", stack->pcs[i]);
+    }
+  }
+}
+
+/**
+ * @brief Writes the sampled stacks in the folded format, one
+ *        "thread;caller;...;pc count" line per stack, optionally clearing
+ *        them.
+ */
+void sampler_render(char *data, size_t size, metrics_flush_t flush,
+                    void *arg, bool reset) {
+  metrics_writer_t *writer = &(metrics_writer_t) {
+    .data = data,
+    .size = size,
+    .len = 0,
+    .flush = flush,
+    .arg = arg,
+  };
+  sampler_stack_t *stack = &sampler_snapshot;
+  char line[16 + SAMPLER_DEPTH * 11];
+
+  for (int i = 0; i < SAMPLER_BUCKETS; i++) {
+    if (sampler_read(i, stack, reset)) {
+      sampler_fold(stack, line, sizeof(line));
+      metrics_printf(writer, "%s %lu\n", line, stack->count);
+    }
+  }
+  if (reset) {
+    sampler_reset();
+  }
+  if (writer->len > 0) {
+    flush(arg, data, writer->len);
+  }
+}
+
+/**
+ * @brief Shell command, "samples [reset]" prints the sampled stacks in the
+ *        folded format.
+ */
+void cmd_samples(BaseSequentialStream *chp, int argc, char *argv[]) {
+  bool reset = argc == 1 && strcmp(argv[0], "reset") == 0;
+  sampler_stack_t *stack = &sampler_snapshot;
+  char line[16 + SAMPLER_DEPTH * 11];
+  uint32_t samples, dropped;
+
+  if (argc > 1 || (argc == 1 && !reset)) {
+    chprintf(chp, "Usage: samples [reset]" SHELL_NEWLINE_STR);
+    return;
+  }
+
+  sampler_totals(&samples, &dropped);
+  for (int i = 0; i < SAMPLER_BUCKETS; i++) {
+    if (sampler_read(i, stack, reset)) {
+      sampler_fold(stack, line, sizeof(line));
+      chprintf(chp, "%s %lu" SHELL_NEWLINE_STR, line, stack->count);
+    }
+  }
+  if (reset) {
+    sampler_reset();
+  }
+  chprintf(chp, "%lu samples, %lu dropped" SHELL_NEWLINE_STR,
+           samples, dropped);
+}
+
+/** @} */
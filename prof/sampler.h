@@ -0,0 +1,108 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file sampler.h
+ * @brief Sampling profiler macros and structures.
+ * @addtogroup PROF_SAMPLER
+ * @{
+ */
+
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+/**
+ * @brief Set by the USE_SAMPLER_UNWIND=yes build, which also emits the
+ *        unwind tables the call stacks are walked with.
+ */
+#ifndef SAMPLER_UNWIND
+#define SAMPLER_UNWIND          FALSE
+#endif
+
+/**
+ * @brief Samples per second, off the system tick rate so the two do not
+ *        beat.
+ */
+#ifndef SAMPLER_FREQUENCY
+#define SAMPLER_FREQUENCY       997
+#endif
+
+/**
+ * @brief Above the other interrupts, the time spent in them is sampled.
+ */
+#ifndef SAMPLER_IRQ_PRIORITY
+#define SAMPLER_IRQ_PRIORITY    3
+#endif
+
+/**
+ * @brief Sampling timer, a basic timer not used by the HAL.
+ */
+#ifndef SAMPLER_TIM
+#define SAMPLER_TIM             STM32_TIM6
+#define SAMPLER_HANDLER         STM32_TIM6_HANDLER
+#define SAMPLER_NUMBER          STM32_TIM6_NUMBER
+#define SAMPLER_RCC_ENABLE()    rccEnableTIM6(true)
+#define SAMPLER_CLOCK           STM32_TIMCLK1
+#endif
+
+/**
+ * @brief Distinct stacks kept, a power of two.
+ */
+#ifndef SAMPLER_BUCKETS
+#define SAMPLER_BUCKETS         128
+#endif
+
+/**
+ * @brief Buckets probed before a new stack is dropped.
+ */
+#ifndef SAMPLER_PROBES
+#define SAMPLER_PROBES          8
+#endif
+
+/**
+ * @brief Frames recorded per sample, only the first without SAMPLER_UNWIND.
+ */
+#ifndef SAMPLER_DEPTH
+#define SAMPLER_DEPTH           6
+#endif
+
+/**
+ * @brief One sampled stack, @p pcs start at the interrupted instruction
+ *        and unused frames are zero.
+ * @details Interrupt handlers are sampled as the "irq" thread without
+ *          frames.
+ */
+typedef struct sampler_stack {
+  const char *thread;
+  uint32_t count;
+  uint32_t pcs[SAMPLER_DEPTH];
+} sampler_stack_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void sampler_start(void);
+  void sampler_totals(uint32_t *samples, uint32_t *dropped);
+  void sampler_render(char *data, size_t size, metrics_flush_t flush,
+                      void *arg, bool reset);
+  void cmd_samples(BaseSequentialStream *chp, int argc, char *argv[]);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SAMPLER_H */
+
+/** @} */
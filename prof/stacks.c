@@ -0,0 +1,177 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file stacks.c
+ * @brief Stack high water mark scanner code.
+ * @details Working areas are painted with CH_DBG_STACK_FILL_VALUE when a
+ *          thread is created, the scanner counts the painted bytes left
+ *          above the base of each stack. The main stack is set up before
+ *          the kernel and is painted by stacks_paint_main() instead.
+ *          Stacks whose base is not painted are reported as unknown.
+ * @addtogroup PROF_STACKS
+ * @{
+ */
+
+#include <string.h>
+
+#include "ch.h"
+#include "hal.h"
+
+#include "chprintf.h"
+#include "shell.h"
+
+#include "latch.h"
+#include "stacks.h"
+
+extern stkalign_t __main_thread_stack_base__, __main_thread_stack_end__;
+
+#if STACKS_WATCHDOG
+static stacks_peaks_t peaks_buf[2];
+
+static latch_t peaks_latch = LATCH_DATA(peaks_buf);
+#endif
+
+static void stacks_bounds(const thread_t *tp, uint8_t **base, uint8_t **end) {
+  if (tp == &ch.mainthread) {
+    *base = (uint8_t *)&__main_thread_stack_base__;
+    *end = (uint8_t *)&__main_thread_stack_end__;
+  } else {
+    /* The descriptor sits at the top of the working area.*/
+    *base = (uint8_t *)tp->wabase;
+    *end = (uint8_t *)tp;
+  }
+}
+
+/**
+ * @brief Paints the unused part of the main stack, called from main().
+ */
+void stacks_paint_main(void) {
+  uint8_t *base = (uint8_t *)&__main_thread_stack_base__;
+  uint8_t *sp = (uint8_t *)__builtin_frame_address(0) - 64;
+
+  if (sp > base) {
+    memset(base, CH_DBG_STACK_FILL_VALUE, sp - base);
+  }
+}
+
+/**
+ * @brief Measures the peak stack usage of @p tp.
+ * @return false if the stack is unknown or was not painted.
+ */
+bool stacks_usage(const thread_t *tp, stacks_usage_t *usage) {
+  uint8_t *base, *end, *p;
+
+  stacks_bounds(tp, &base, &end);
+  if (base == NULL || end <= base || *base != CH_DBG_STACK_FILL_VALUE) {
+    return false;
+  }
+  for (p = base; p < end && *p == CH_DBG_STACK_FILL_VALUE; p++) {
+  }
+  usage->size = end - base;
+  usage->used = end - p;
+  return true;
+}
+
+/**
+ * @brief Copies the peaks recorded by the watchdog, lock free.
+ */
+void stacks_read(stacks_peaks_t *peaks) {
+#if STACKS_WATCHDOG
+  latch_read(&peaks_latch, peaks);
+#else
+  peaks->count = 0;
+#endif
+}
+
+/**
+ * @brief Shell command, "stacks" prints the stack usage of each thread.
+ */
+void cmd_stacks(BaseSequentialStream *chp, int argc, char *argv[]) {
+  thread_t *tp;
+
+  (void)argv;
+  if (argc > 0) {
+    chprintf(chp, "Usage: stacks" SHELL_NEWLINE_STR);
+    return;
+  }
+
+  chprintf(chp, "name              size  used  free" SHELL_NEWLINE_STR);
+  tp = chRegFirstThread();
+  while (tp) {
+    stacks_usage_t usage;
+
+    chprintf(chp, "%-16s", tp->name ? tp->name : "");
+    if (stacks_usage(tp, &usage)) {
+      chprintf(chp, " %5u %5u %5u%s" SHELL_NEWLINE_STR, usage.size,
+               usage.used, usage.size - usage.used,
+               usage.size - usage.used < STACKS_MARGIN ? " low" : "");
+    } else {
+      chprintf(chp, "     ?     ?     ?" SHELL_NEWLINE_STR);
+    }
+    tp = chRegNextThread(tp);
+  }
+}
+
+#if STACKS_WATCHDOG
+THD_WORKING_AREA(wa_stacks, STACKS_THREAD_STACK_SIZE);
+
+THD_FUNCTION(stacks_thread, p) {
+  static stacks_peaks_t peaks;
+
+  (void)p;
+  chRegSetThreadName("stacks");
+
+  while (true) {
+    thread_t *tp = chRegFirstThread();
+    bool changed = false;
+
+    while (tp) {
+      stacks_usage_t usage;
+      stacks_peak_t *peak = NULL;
+
+      if (stacks_usage(tp, &usage)) {
+        for (int i = 0; i < peaks.count; i++) {
+          if (peaks.peaks[i].thread == tp) {
+            peak = &peaks.peaks[i];
+            break;
+          }
+        }
+        if (peak == NULL && peaks.count < STACKS_PEAKS) {
+          peak = &peaks.peaks[peaks.count++];
+          peak->thread = tp;
+          peak->used = 0;
+        }
+        if (peak != NULL && usage.used > peak->used) {
+          peak->name = tp->name;
+          peak->size = usage.size;
+          peak->used = usage.used;
+          peak->time = chVTGetSystemTimeX();
+          changed = true;
+        }
+      }
+      tp = chRegNextThread(tp);
+    }
+    if (changed) {
+      latch_write(&peaks_latch, &peaks);
+    }
+
+    chThdSleepMilliseconds(STACKS_PERIOD_MS);
+  }
+}
+#endif
+
+/** @} */
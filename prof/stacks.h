@@ -0,0 +1,102 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file stacks.h
+ * @brief Stack high water mark scanner macros and structures.
+ * @addtogroup PROF_STACKS
+ * @{
+ */
+
+#ifndef STACKS_H
+#define STACKS_H
+
+/**
+ * @brief Background thread keeping the peak of every thread ever seen.
+ */
+#ifndef STACKS_WATCHDOG
+#define STACKS_WATCHDOG             TRUE
+#endif
+
+#ifndef STACKS_THREAD_STACK_SIZE
+#define STACKS_THREAD_STACK_SIZE    256
+#endif
+
+#ifndef STACKS_THREAD_PRIORITY
+#define STACKS_THREAD_PRIORITY      (LOWPRIO + 1)
+#endif
+
+#ifndef STACKS_PERIOD_MS
+#define STACKS_PERIOD_MS            1000
+#endif
+
+/**
+ * @brief Threads remembered by the watchdog.
+ */
+#ifndef STACKS_PEAKS
+#define STACKS_PEAKS                16
+#endif
+
+/**
+ * @brief Unused bytes under which a stack is reported as low.
+ */
+#ifndef STACKS_MARGIN
+#define STACKS_MARGIN               64
+#endif
+
+typedef struct stacks_usage {
+  size_t size;
+  size_t used;
+} stacks_usage_t;
+
+/**
+ * @brief Highest usage of a thread seen by the watchdog.
+ * @details @p thread is only an identity, the thread may have exited.
+ */
+typedef struct stacks_peak {
+  const void *thread;
+  const char *name;
+  uint32_t size;
+  uint32_t used;
+  systime_t time;
+} stacks_peak_t;
+
+typedef struct stacks_peaks {
+  int count;
+  stacks_peak_t peaks[STACKS_PEAKS];
+} stacks_peaks_t;
+
+#if STACKS_WATCHDOG
+extern THD_WORKING_AREA(wa_stacks, STACKS_THREAD_STACK_SIZE);
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void stacks_paint_main(void);
+  bool stacks_usage(const thread_t *tp, stacks_usage_t *usage);
+  void stacks_read(stacks_peaks_t *peaks);
+  void cmd_stacks(BaseSequentialStream *chp, int argc, char *argv[]);
+#if STACKS_WATCHDOG
+  THD_FUNCTION(stacks_thread, p);
+#endif
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STACKS_H */
+
+/** @} */
@@ -0,0 +1,143 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file trace.c
+ * @brief Kernel and span trace ring code.
+ * @details Writers reserve a slot with an atomic increment of the head, so
+ *          threads and nested interrupts never wait on each other. Once the
+ *          ring wraps the oldest records are overwritten. An export stops
+ *          recording while the ring is walked, the trace ends at the request
+ *          that asked for it.
+ *          The sampler and the latency probe interrupt at a fixed rate,
+ *          their records would only push the others out of the ring, they
+ *          are not traced.
+ * @addtogroup PROF_TRACE
+ * @{
+ */
+
+#include "ch.h"
+#include "hal.h"
+
+#include "prof.h"
+#include "cpu.h"
+#include "metrics.h"
+#include "irq.h"
+#include "sampler.h"
+#include "trace.h"
+
+static trace_record_t trace_ring[TRACE_RECORDS];
+
+static uint32_t trace_head;
+
+static volatile bool trace_enabled = true;
+
+static void trace_write(uint16_t type, uint16_t arg, const void *object) {
+  trace_record_t *record;
+
+  if (!trace_enabled) {
+    return;
+  }
+  record = &trace_ring[__atomic_fetch_add(&trace_head, 1, __ATOMIC_RELAXED) &
+                       (TRACE_RECORDS - 1)];
+  record->time = CPU_CYCLES();
+  record->object = object;
+  record->type = type;
+  record->arg = arg;
+}
+
+/**
+ * @brief Context switch hook, called in the kernel critical zone.
+ */
+void trace_switch(struct ch_thread *ntp) {
+  trace_write(TRACE_SWITCH, 0, ntp);
+}
+
+static inline bool trace_irq_traced(uint32_t vector) {
+  return vector != SAMPLER_NUMBER + NVIC_USER_IRQ_OFFSET &&
+         (!IRQ_PROBE || vector != IRQ_PROBE_NUMBER + NVIC_USER_IRQ_OFFSET);
+}
+
+/**
+ * @brief ISR enter hook, records the active vector.
+ */
+void trace_irq_enter(void) {
+  uint32_t vector = SCB->ICSR & SCB_ICSR_VECTACTIVE_Msk;
+
+  if (trace_irq_traced(vector)) {
+    trace_write(TRACE_IRQ_ENTER, vector, NULL);
+  }
+}
+
+/**
+ * @brief ISR exit hook.
+ */
+void trace_irq_leave(void) {
+  uint32_t vector = SCB->ICSR & SCB_ICSR_VECTACTIVE_Msk;
+
+  if (trace_irq_traced(vector)) {
+    trace_write(TRACE_IRQ_LEAVE, vector, NULL);
+  }
+}
+
+/**
+ * @brief Opens a span on the current thread, @p name must be static.
+ */
+void trace_begin(const char *name) {
+  trace_write(TRACE_SPAN_BEGIN, 0, name);
+}
+
+/**
+ * @brief Closes the span opened with the same @p name.
+ */
+void trace_end(const char *name) {
+  trace_write(TRACE_SPAN_END, 0, name);
+}
+
+/**
+ * @brief Walks the ring from the oldest record, recording is stopped
+ *        meanwhile.
+ * @note  Not reentrant, there is a single exporter.
+ */
+void trace_export(trace_emit_t emit, void *arg) {
+  uint32_t head, i;
+  uint32_t last = 0;
+  uint64_t time = 0;
+
+  trace_enabled = false;
+  head = __atomic_load_n(&trace_head, __ATOMIC_RELAXED);
+  i = head > TRACE_RECORDS ? head - TRACE_RECORDS : 0;
+  if (i < head) {
+    last = trace_ring[i & (TRACE_RECORDS - 1)].time;
+  }
+
+  for (; i < head; i++) {
+    const trace_record_t *record = &trace_ring[i & (TRACE_RECORDS - 1)];
+
+    /* Records are close to time order, the signed delta also unwraps the
+       counter.*/
+    int32_t delta = (int32_t)(record->time - last);
+    if (delta > 0 || (uint64_t)-delta <= time) {
+      time += delta;
+    }
+    last = record->time;
+    emit(arg, record, time);
+  }
+
+  trace_enabled = true;
+}
+
+/** @} */
@@ -0,0 +1,70 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file trace.h
+ * @brief Kernel and span trace ring macros and structures.
+ * @addtogroup PROF_TRACE
+ * @{
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+/**
+ * @brief Records kept in the ring, a power of two.
+ */
+#ifndef TRACE_RECORDS
+#define TRACE_RECORDS           1024
+#endif
+
+typedef enum {
+  TRACE_SWITCH = 1,
+  TRACE_IRQ_ENTER,
+  TRACE_IRQ_LEAVE,
+  TRACE_SPAN_BEGIN,
+  TRACE_SPAN_END
+} trace_type_t;
+
+/**
+ * @brief Ring record, @p object is the thread switched in or the span name.
+ */
+typedef struct trace_record {
+  uint32_t time;
+  const void *object;
+  uint16_t type;
+  uint16_t arg;
+} trace_record_t;
+
+/**
+ * @brief Receives each record with its time in cycles since the oldest one.
+ */
+typedef void (*trace_emit_t)(void *arg, const trace_record_t *record,
+                             uint64_t time);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void trace_begin(const char *name);
+  void trace_end(const char *name);
+  void trace_export(trace_emit_t emit, void *arg);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TRACE_H */
+
+/** @} */
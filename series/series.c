@@ -0,0 +1,657 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file series.c
+ * @brief Time series store code.
+ * @details Each series is a ring of compressed blocks written by a single
+ *          producer without locks. Bits are only ever added to zeroed
+ *          memory so the published part of a block never changes, readers
+ *          copy a block and then check that the producer did not recycle
+ *          it meanwhile, so neither side ever waits.
+ *          Queries downsample while scanning, either averaging fixed time
+ *          buckets or selecting one sample per bucket with the Largest
+ *          Triangle Three Buckets algorithm.
+ * @addtogroup SERIES
+ * @{
+ */
+
+#include <string.h>
+
+#include "ch.h"
+
+#include "series.h"
+
+#define SERIES_BARRIER() __asm__ volatile ("" : : : "memory")
+
+/* Worst case sample, 4 + 32 bits of time and 2 + 5 + 5 + 32 of value.*/
+#define SERIES_SAMPLE_BITS      80
+
+/* Raw samples are visited as rollups of a single sample.*/
+typedef void (*series_visit_t)(void *arg, const series_rollup_t *rollup);
+
+typedef struct series_cursor {
+  const series_query_t *query;
+  series_emit_t emit;
+  void *arg;
+  int count;
+  int bucket;
+  series_point_t point;
+  float sum;
+  uint32_t samples;
+  float area;
+  float prev_time;
+  float prev_value;
+  float next_time;
+  float next_value;
+} series_cursor_t;
+
+static series_t *series_head;
+static series_t *series_tail;
+
+static const uint32_t series_periods[SERIES_TIERS] = SERIES_TIER_PERIODS;
+
+static uint32_t float_bits(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+static float bits_float(uint32_t bits) {
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+static int leading_zeros(uint32_t x) {
+  return __builtin_clz(x);
+}
+
+static int trailing_zeros(uint32_t x) {
+  return __builtin_ctz(x);
+}
+
+/* Bits are stored MSB first into zeroed bytes.*/
+static void bits_write(uint8_t *data, uint16_t *pos, uint32_t value, int n) {
+  while (n > 0) {
+    int shift = 7 - (*pos & 7);
+    int take = n < shift + 1 ? n : shift + 1;
+    uint32_t chunk = (value >> (n - take)) & ((1U << take) - 1);
+    data[*pos >> 3] |= (uint8_t)(chunk << (shift + 1 - take));
+    *pos += take;
+    n -= take;
+  }
+}
+
+static uint32_t bits_read(const uint8_t *data, uint16_t *pos, int n) {
+  uint32_t value = 0;
+  while (n > 0) {
+    int shift = 7 - (*pos & 7);
+    int take = n < shift + 1 ? n : shift + 1;
+    uint32_t chunk = (data[*pos >> 3] >> (shift + 1 - take)) &
+                     ((1U << take) - 1);
+    value = (value << take) | chunk;
+    *pos += take;
+    n -= take;
+  }
+  return value;
+}
+
+static int32_t sign_extend(uint32_t value, int n) {
+  uint32_t sign = 1U << (n - 1);
+  return (int32_t)((value ^ sign) - sign);
+}
+
+static void series_encode(series_block_t *block, series_encoder_t *encoder,
+                          uint32_t time, uint32_t value) {
+  int32_t delta = (int32_t)(time - encoder->time);
+  int32_t dod = delta - encoder->delta;
+  uint32_t xor = value ^ encoder->value;
+
+  if (dod == 0) {
+    bits_write(block->data, &encoder->bits, 0x0, 1);
+  } else if (dod >= -64 && dod < 64) {
+    bits_write(block->data, &encoder->bits, 0x2, 2);
+    bits_write(block->data, &encoder->bits, (uint32_t)dod & 0x7F, 7);
+  } else if (dod >= -256 && dod < 256) {
+    bits_write(block->data, &encoder->bits, 0x6, 3);
+    bits_write(block->data, &encoder->bits, (uint32_t)dod & 0x1FF, 9);
+  } else if (dod >= -2048 && dod < 2048) {
+    bits_write(block->data, &encoder->bits, 0xE, 4);
+    bits_write(block->data, &encoder->bits, (uint32_t)dod & 0xFFF, 12);
+  } else {
+    bits_write(block->data, &encoder->bits, 0xF, 4);
+    bits_write(block->data, &encoder->bits, (uint32_t)dod, 32);
+  }
+
+  if (xor == 0) {
+    bits_write(block->data, &encoder->bits, 0x0, 1);
+  } else {
+    int leading = leading_zeros(xor);
+    int trailing = trailing_zeros(xor);
+
+    if (leading >= encoder->leading && trailing >= encoder->trailing) {
+      /* Fits in the previous meaningful window.*/
+      bits_write(block->data, &encoder->bits, 0x2, 2);
+      bits_write(block->data, &encoder->bits, xor >> encoder->trailing,
+                 32 - encoder->leading - encoder->trailing);
+    } else {
+      int length = 32 - leading - trailing;
+      bits_write(block->data, &encoder->bits, 0x3, 2);
+      bits_write(block->data, &encoder->bits, leading, 5);
+      bits_write(block->data, &encoder->bits, length - 1, 5);
+      bits_write(block->data, &encoder->bits, xor >> trailing, length);
+      encoder->leading = leading;
+      encoder->trailing = trailing;
+    }
+  }
+
+  encoder->time = time;
+  encoder->delta = delta;
+  encoder->value = value;
+}
+
+/*
+ * Decodes a block copy, visiting the samples of [from, to].
+ * Returns false once past @p to.
+ */
+static bool series_decode(const series_block_t *block, uint32_t count,
+                          uint32_t from, uint32_t to,
+                          series_visit_t visit, void *arg) {
+  series_rollup_t sample = {.count = 1};
+  uint32_t time = block->time;
+  int32_t delta = 0;
+  uint32_t value = block->value;
+  int leading = 32, trailing = 0;
+  uint16_t pos = 0;
+
+  for (uint32_t i = 0; i < count; i++) {
+    if (i > 0) {
+      int32_t dod;
+
+      if (bits_read(block->data, &pos, 1) == 0) {
+        dod = 0;
+      } else if (bits_read(block->data, &pos, 1) == 0) {
+        dod = sign_extend(bits_read(block->data, &pos, 7), 7);
+      } else if (bits_read(block->data, &pos, 1) == 0) {
+        dod = sign_extend(bits_read(block->data, &pos, 9), 9);
+      } else if (bits_read(block->data, &pos, 1) == 0) {
+        dod = sign_extend(bits_read(block->data, &pos, 12), 12);
+      } else {
+        dod = (int32_t)bits_read(block->data, &pos, 32);
+      }
+      delta += dod;
+      time += (uint32_t)delta;
+
+      if (bits_read(block->data, &pos, 1) != 0) {
+        if (bits_read(block->data, &pos, 1) != 0) {
+          leading = bits_read(block->data, &pos, 5);
+          trailing = 32 - leading - (bits_read(block->data, &pos, 5) + 1);
+        }
+        value ^= bits_read(block->data, &pos, 32 - leading - trailing) <<
+                 trailing;
+      }
+    }
+
+    if (time > to) {
+      return false;
+    }
+    if (time >= from) {
+      sample.time = time;
+      sample.min = sample.max = sample.sum = bits_float(value);
+      visit(arg, &sample);
+    }
+  }
+  return true;
+}
+
+/*
+ * Visits the samples of [from, to] still in the ring, oldest first.
+ */
+static void series_scan(const series_t *series, uint32_t from, uint32_t to,
+                        series_visit_t visit, void *arg) {
+  static series_block_t copy;
+  uint32_t head = series->head;
+  uint32_t i = head - (head <= series->mask ? head : series->mask + 1);
+
+  for (; i != head; i++) {
+    const series_block_t *block = &series->blocks[i & series->mask];
+    uint32_t count;
+
+    /* Blocks starting before the next one are entirely before from.*/
+    if (i + 1 != head) {
+      const series_block_t *next = &series->blocks[(i + 1) & series->mask];
+      if (next->seq == i + 2 && next->time <= from) {
+        continue;
+      }
+    }
+
+    count = block->count;
+    SERIES_BARRIER();
+    memcpy(&copy, block, sizeof(copy));
+    SERIES_BARRIER();
+    if (block->seq != i + 1 || copy.seq != i + 1) {
+      /* Recycled while being copied.*/
+      continue;
+    }
+    if (!series_decode(&copy, count, from, to, visit, arg)) {
+      break;
+    }
+  }
+}
+
+/*
+ * Visits the closed buckets of tier @p t starting in [from, to].
+ */
+static void series_scan_tier(const series_t *series, int t,
+                             uint32_t from, uint32_t to,
+                             series_visit_t visit, void *arg) {
+  const series_tier_t *tier = &series->tiers[t];
+  const series_rollup_t *rollups = &series->rollups[t * SERIES_TIER_SIZE];
+  uint32_t mask = SERIES_TIER_SIZE - 1;
+  uint32_t head = tier->head;
+  uint32_t i = head - (head < mask ? head : mask);
+
+  for (; i != head; i++) {
+    series_rollup_t rollup = rollups[i & mask];
+    SERIES_BARRIER();
+    if (tier->head - i > mask) {
+      /* Overwritten while being copied.*/
+      continue;
+    }
+    if (rollup.time < from) {
+      continue;
+    }
+    if (rollup.time > to) {
+      break;
+    }
+    visit(arg, &rollup);
+  }
+}
+
+/*
+ * Time of the oldest sample of tier @p t, of the raw samples if negative.
+ */
+static bool series_oldest(const series_t *series, int t, uint32_t *time) {
+  if (t < 0) {
+    uint32_t head = series->head;
+    uint32_t i = head - (head <= series->mask ? head : series->mask + 1);
+    const series_block_t *block = &series->blocks[i & series->mask];
+
+    if (head == 0 || block->seq != i + 1) {
+      return false;
+    }
+    *time = block->time;
+    return true;
+  } else {
+    const series_tier_t *tier = &series->tiers[t];
+    uint32_t mask = SERIES_TIER_SIZE - 1;
+    uint32_t head = tier->head;
+
+    if (head == 0) {
+      return false;
+    }
+    *time = series->rollups[t * SERIES_TIER_SIZE +
+                            ((head - (head < mask ? head : mask)) & mask)].time;
+    return true;
+  }
+}
+
+/*
+ * Coarsest tier not coarser than the query resolution that reaches back
+ * to from, otherwise the finest coarser tier that does, otherwise the one
+ * with the longest history. Returns -1 for the raw samples.
+ * from is first raised to the oldest stored data: rollups are stamped with
+ * the start of their period, a tier only holds older data than the raw
+ * samples if it reaches back more than one period further.
+ */
+static int series_tier_select(const series_t *series,
+                              const series_query_t *query) {
+  uint32_t oldest[SERIES_TIERS + 1];
+  bool valid[SERIES_TIERS + 1];
+  uint32_t from = UINT32_MAX;
+  uint32_t resolution;
+  int best = -1;
+
+  /* Index 0 is the raw samples.*/
+  for (int t = -1; t < SERIES_TIERS; t++) {
+    valid[t + 1] = series_oldest(series, t, &oldest[t + 1]);
+    if (valid[t + 1]) {
+      uint32_t start = t < 0 ? oldest[0]
+                             : oldest[t + 1] + series_periods[t] - 1;
+      if (start < from) {
+        from = start;
+      }
+    }
+  }
+  if (from < query->from || from > query->to) {
+    from = query->from;
+  }
+  resolution = (query->to - from) / query->points;
+
+  for (int t = SERIES_TIERS - 1; t >= -1; t--) {
+    if ((t < 0 || series_periods[t] <= resolution) &&
+        valid[t + 1] && oldest[t + 1] <= from) {
+      return t;
+    }
+  }
+  for (int t = 0; t < SERIES_TIERS; t++) {
+    if (series_periods[t] > resolution &&
+        valid[t + 1] && oldest[t + 1] <= from) {
+      return t;
+    }
+  }
+  for (int t = 0; t < SERIES_TIERS; t++) {
+    if (valid[t + 1] && (!valid[best + 1] || oldest[t + 1] < oldest[best + 1])) {
+      best = t;
+    }
+  }
+  return best;
+}
+
+static void series_scan_query(const series_t *series, int t,
+                              const series_query_t *query,
+                              series_visit_t visit, void *arg) {
+  if (t < 0) {
+    series_scan(series, query->from, query->to, visit, arg);
+  } else {
+    series_scan_tier(series, t, query->from, query->to, visit, arg);
+  }
+}
+
+static void series_rollup_add(series_rollup_t *rollup, uint32_t time,
+                              float value) {
+  if (rollup->count == 0) {
+    rollup->time = time;
+    rollup->min = value;
+    rollup->max = value;
+    rollup->sum = 0.0f;
+  }
+  if (value < rollup->min) {
+    rollup->min = value;
+  }
+  if (value > rollup->max) {
+    rollup->max = value;
+  }
+  rollup->sum += value;
+  rollup->count++;
+}
+
+static void series_tiers_update(series_t *series, uint32_t time,
+                                float value) {
+  for (int t = 0; t < SERIES_TIERS; t++) {
+    series_tier_t *tier = &series->tiers[t];
+    uint32_t start = time - time % series_periods[t];
+
+    if (tier->open.count > 0 && tier->open.time != start) {
+      uint32_t head = tier->head;
+      series->rollups[t * SERIES_TIER_SIZE +
+                      (head & (SERIES_TIER_SIZE - 1))] = tier->open;
+      SERIES_BARRIER();
+      tier->head = head + 1;
+      tier->open.count = 0;
+    }
+    series_rollup_add(&tier->open, start, value);
+  }
+}
+
+static int series_bucket(const series_query_t *query, uint32_t time) {
+  uint64_t span = (uint64_t)query->to - query->from + 1;
+  return (int)((uint64_t)(time - query->from) * query->points / span);
+}
+
+static uint32_t series_bucket_time(const series_query_t *query, int bucket) {
+  uint64_t span = (uint64_t)query->to - query->from + 1;
+  return query->from + (uint32_t)(span * bucket / query->points);
+}
+
+static void series_emit(series_cursor_t *cursor) {
+  cursor->emit(cursor->arg, &cursor->point);
+  cursor->count++;
+}
+
+static void series_visit_bucket(void *arg, const series_rollup_t *rollup) {
+  series_cursor_t *cursor = arg;
+  int bucket = series_bucket(cursor->query, rollup->time);
+
+  if (bucket != cursor->bucket) {
+    if (cursor->samples > 0) {
+      cursor->point.value = cursor->sum / cursor->samples;
+      series_emit(cursor);
+    }
+    cursor->bucket = bucket;
+    cursor->point.time = series_bucket_time(cursor->query, bucket);
+    cursor->point.min = rollup->min;
+    cursor->point.max = rollup->max;
+    cursor->sum = 0.0f;
+    cursor->samples = 0;
+  }
+
+  if (rollup->min < cursor->point.min) {
+    cursor->point.min = rollup->min;
+  }
+  if (rollup->max > cursor->point.max) {
+    cursor->point.max = rollup->max;
+  }
+  cursor->sum += rollup->sum;
+  cursor->samples += rollup->count;
+}
+
+static void series_visit_average(void *arg, const series_rollup_t *rollup) {
+  series_cursor_t *cursor = arg;
+  series_bucket_t *bucket =
+      &cursor->query->buckets[series_bucket(cursor->query, rollup->time)];
+
+  bucket->time += (float)(rollup->time - cursor->query->from) * rollup->count;
+  bucket->sum += rollup->sum;
+  bucket->count += rollup->count;
+}
+
+static void series_lttb_select(series_cursor_t *cursor) {
+  cursor->prev_time = (float)(cursor->point.time - cursor->query->from);
+  cursor->prev_value = cursor->point.value;
+  cursor->point.min = cursor->point.value;
+  cursor->point.max = cursor->point.value;
+  series_emit(cursor);
+}
+
+static void series_visit_lttb(void *arg, const series_rollup_t *rollup) {
+  series_cursor_t *cursor = arg;
+  const series_query_t *query = cursor->query;
+  int bucket = series_bucket(query, rollup->time);
+  float time = (float)(rollup->time - query->from);
+  float value = rollup->sum / rollup->count;
+  float area;
+
+  if (bucket != cursor->bucket) {
+    int next = bucket + 1;
+
+    if (cursor->samples > 0) {
+      series_lttb_select(cursor);
+    }
+    cursor->bucket = bucket;
+    cursor->samples = 0;
+
+    /* Third vertex, the average of the next non empty bucket.*/
+    while (next < query->points && query->buckets[next].count == 0) {
+      next++;
+    }
+    if (next < query->points) {
+      cursor->next_time = query->buckets[next].time;
+      cursor->next_value = query->buckets[next].sum;
+    } else {
+      cursor->next_time = -1.0f;
+    }
+  }
+
+  if (cursor->count == 0) {
+    /* The first sample is always kept.*/
+    area = cursor->samples == 0 ? 1.0f : -1.0f;
+  } else if (cursor->next_time < 0.0f) {
+    /* So is the last one.*/
+    area = (float)cursor->samples;
+  } else {
+    area = (cursor->prev_time - cursor->next_time) *
+           (value - cursor->prev_value) -
+           (cursor->prev_time - time) *
+           (cursor->next_value - cursor->prev_value);
+    if (area < 0.0f) {
+      area = -area;
+    }
+  }
+
+  if (cursor->samples == 0 || area > cursor->area) {
+    cursor->area = area;
+    cursor->point.time = rollup->time;
+    cursor->point.value = value;
+  }
+  cursor->samples++;
+}
+
+/**
+ * @brief Milliseconds timestamp used by the producers.
+ */
+uint32_t series_now(void) {
+  return TIME_I2MS(chVTGetSystemTimeX());
+}
+
+/**
+ * @brief Makes @p series visible to queries.
+ */
+void series_register(series_t *series) {
+  series->next = NULL;
+
+  chSysLock();
+  if (series_tail) {
+    series_tail->next = series;
+  } else {
+    series_head = series;
+  }
+  series_tail = series;
+  chSysUnlock();
+}
+
+series_t *series_find(const char *name) {
+  series_t *series = series_head;
+  while (series && strcmp(series->name, name) != 0) {
+    series = series->next;
+  }
+  return series;
+}
+
+series_t *series_first(void) {
+  return series_head;
+}
+
+/**
+ * @brief Appends a sample, only the producer of @p series may call it.
+ * @note  @p time must not decrease between calls.
+ */
+void series_append(series_t *series, uint32_t time, float value) {
+  series_encoder_t *encoder = &series->encoder;
+  uint32_t head = series->head;
+  series_block_t *block = &series->blocks[(head - 1) & series->mask];
+
+  series_tiers_update(series, time, value);
+
+  if (head == 0 ||
+      encoder->bits + SERIES_SAMPLE_BITS > SERIES_BLOCK_DATA * 8) {
+    /* Recycles the oldest block, invalidating it first.*/
+    block = &series->blocks[head & series->mask];
+    block->seq = 0;
+    SERIES_BARRIER();
+    block->count = 1;
+    block->time = time;
+    block->value = float_bits(value);
+    memset(block->data, 0, sizeof(block->data));
+    SERIES_BARRIER();
+    block->seq = head + 1;
+    series->head = head + 1;
+
+    *encoder = (series_encoder_t) {
+      .time = time,
+      .delta = 0,
+      .value = block->value,
+      .leading = 32,
+      .trailing = 0,
+      .bits = 0,
+    };
+    return;
+  }
+
+  series_encode(block, encoder, time, float_bits(value));
+  SERIES_BARRIER();
+  block->count++;
+}
+
+/**
+ * @brief Downsamples [from, to] of @p series to at most @p points points.
+ * @details The coarsest rollup tier whose period does not exceed the
+ *          query resolution is scanned instead of the raw samples when it
+ *          reaches back far enough, so the cost of long windows does not
+ *          grow with their length. Empty buckets produce no point.
+ *          SERIES_LTTB scans twice, first to average the buckets then to
+ *          select the samples.
+ * @note  Queries share a block buffer, only one thread may run them.
+ * @return The number of points emitted, -1 if @p query is invalid.
+ */
+int series_query(const series_t *series, series_query_t *query,
+                 series_emit_t emit, void *arg) {
+  series_cursor_t *cursor = &(series_cursor_t) {
+    .query = query,
+    .emit = emit,
+    .arg = arg,
+    .count = 0,
+    .bucket = -1,
+    .samples = 0,
+  };
+  int t;
+
+  if (query->from > query->to || query->points < 1 ||
+      query->points > SERIES_POINTS_MAX) {
+    return -1;
+  }
+
+  t = series_tier_select(series, query);
+  query->period = t < 0 ? 0 : series_periods[t];
+
+  if (query->mode == SERIES_BUCKETS) {
+    series_scan_query(series, t, query, series_visit_bucket, cursor);
+    if (cursor->samples > 0) {
+      cursor->point.value = cursor->sum / cursor->samples;
+      series_emit(cursor);
+    }
+    return cursor->count;
+  }
+
+  memset(query->buckets, 0, query->points * sizeof(series_bucket_t));
+  series_scan_query(series, t, query, series_visit_average, cursor);
+  for (int i = 0; i < query->points; i++) {
+    series_bucket_t *bucket = &query->buckets[i];
+    if (bucket->count > 0) {
+      bucket->time /= bucket->count;
+      bucket->sum /= bucket->count;
+    }
+  }
+
+  series_scan_query(series, t, query, series_visit_lttb, cursor);
+  if (cursor->samples > 0) {
+    series_lttb_select(cursor);
+  }
+  return cursor->count;
+}
+
+/** @} */
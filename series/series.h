@@ -0,0 +1,217 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file series.h
+ * @brief Time series store macros and structures.
+ * @addtogroup SERIES
+ * @{
+ */
+
+#ifndef SERIES_H
+#define SERIES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Upper bound of the points returned by a query.
+ */
+#ifndef SERIES_POINTS_MAX
+#define SERIES_POINTS_MAX       256
+#endif
+
+#ifndef SERIES_POINTS_DEFAULT
+#define SERIES_POINTS_DEFAULT   200
+#endif
+
+/**
+ * @brief Compressed block size in bytes, header included.
+ */
+#ifndef SERIES_BLOCK_SIZE
+#define SERIES_BLOCK_SIZE       256
+#endif
+
+#define SERIES_BLOCK_DATA       (SERIES_BLOCK_SIZE - 16)
+
+/**
+ * @brief Rollup tiers maintained by each series.
+ */
+#ifndef SERIES_TIERS
+#define SERIES_TIERS            3
+#endif
+
+/**
+ * @brief Bucket period of each tier in milliseconds, finest first.
+ */
+#ifndef SERIES_TIER_PERIODS
+#define SERIES_TIER_PERIODS     {1000, 60000, 3600000}
+#endif
+
+/**
+ * @brief Buckets kept in each tier, a power of two.
+ */
+#ifndef SERIES_TIER_SIZE
+#define SERIES_TIER_SIZE        64
+#endif
+
+/**
+ * @brief Declares a series named @p label holding the last @p count
+ *        compressed blocks, @p count must be a power of two.
+ */
+#define SERIES_DECL(var, label, count)                                      \
+  static series_block_t var##_blocks[count];                                \
+  static series_rollup_t var##_rollups[SERIES_TIERS * SERIES_TIER_SIZE];    \
+  series_t var = {                                                          \
+    .name = (label),                                                        \
+    .blocks = var##_blocks,                                                 \
+    .mask = (count) - 1,                                                    \
+    .head = 0,                                                              \
+    .rollups = var##_rollups,                                               \
+    .next = NULL,                                                           \
+  }
+
+typedef struct series_sample {
+  uint32_t time;
+  float value;
+} series_sample_t;
+
+/**
+ * @brief Block of samples compressed as in Facebook's Gorilla.
+ * @details Timestamps are stored as delta of deltas and values as the XOR
+ *          with the previous value, both with variable length codes. The
+ *          first sample is kept in the header.
+ *          @p seq is the block number, @p count is only increased after the
+ *          bits of the new sample are in @p data.
+ */
+typedef struct series_block {
+  volatile uint32_t seq;
+  volatile uint32_t count;
+  uint32_t time;
+  uint32_t value;
+  uint8_t data[SERIES_BLOCK_DATA];
+} series_block_t;
+
+/**
+ * @brief Encoder state, only used by the producer.
+ */
+typedef struct series_encoder {
+  uint32_t time;
+  int32_t delta;
+  uint32_t value;
+  uint8_t leading;
+  uint8_t trailing;
+  uint16_t bits;
+} series_encoder_t;
+
+/**
+ * @brief Aggregate of the samples of [@p time, @p time + period).
+ */
+typedef struct series_rollup {
+  uint32_t time;
+  uint32_t count;
+  float min;
+  float max;
+  float sum;
+} series_rollup_t;
+
+/**
+ * @brief Ring of closed buckets of one period.
+ * @details The bucket being filled is private to the producer, it is only
+ *          published once the first sample of the next period arrives.
+ */
+typedef struct series_tier {
+  volatile uint32_t head;
+  series_rollup_t open;
+} series_tier_t;
+
+/**
+ * @brief Ring of compressed blocks with a single producer.
+ * @details @p head counts the blocks ever opened, the producer appends to
+ *          block @p head - 1 and recycles the oldest one when it is full.
+ *          Every append also updates the rollup tiers.
+ */
+typedef struct series {
+  const char *name;
+  series_block_t *blocks;
+  uint32_t mask;
+  volatile uint32_t head;
+  series_encoder_t encoder;
+  series_rollup_t *rollups;
+  series_tier_t tiers[SERIES_TIERS];
+  struct series *next;
+} series_t;
+
+typedef enum {
+  SERIES_BUCKETS,
+  SERIES_LTTB,
+} series_mode_t;
+
+/**
+ * @brief One downsampled point.
+ * @details In SERIES_BUCKETS mode @p time is the bucket start and @p value
+ *          the average, in SERIES_LTTB mode @p min and @p max are equal to
+ *          the selected sample @p value.
+ */
+typedef struct series_point {
+  uint32_t time;
+  float value;
+  float min;
+  float max;
+} series_point_t;
+
+/**
+ * @brief Per bucket accumulator, a query uses @p points of them.
+ */
+typedef struct series_bucket {
+  float time;
+  float sum;
+  uint32_t count;
+} series_bucket_t;
+
+/**
+ * @brief Query parameters, @p period is set by series_query() to the tier
+ *        period used or to 0 if raw samples were scanned.
+ */
+typedef struct series_query {
+  uint32_t from;
+  uint32_t to;
+  int points;
+  series_mode_t mode;
+  series_bucket_t *buckets;
+  uint32_t period;
+} series_query_t;
+
+typedef void (*series_emit_t)(void *arg, const series_point_t *point);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  uint32_t series_now(void);
+  void series_register(series_t *series);
+  series_t *series_find(const char *name);
+  series_t *series_first(void);
+  void series_append(series_t *series, uint32_t time, float value);
+  int series_query(const series_t *series, series_query_t *query,
+                   series_emit_t emit, void *arg);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SERIES_H */
+
+/** @} */
@@ -0,0 +1,72 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file latch.h
+ * @brief Single producer, lock free double buffer.
+ * @details The writer bumps @p seq before updating each of the two copies so
+ *          readers always copy the one not being written, retrying only if
+ *          @p seq moved during the copy. Neither side ever waits on the
+ *          other, a reader that preempts the producer cannot stall it.
+ * @addtogroup STATUS
+ * @{
+ */
+
+#ifndef LATCH_H
+#define LATCH_H
+
+#include <string.h>
+
+#define LATCH_BARRIER() __asm__ volatile ("" : : : "memory")
+
+typedef struct latch {
+  volatile uint32_t seq;
+  void *buf[2];
+  size_t size;
+} latch_t;
+
+/**
+ * @brief Static initializer, @p copies is an array of two elements.
+ */
+#define LATCH_DATA(copies) {                                                \
+  .seq = 0,                                                                 \
+  .buf = {&(copies)[0], &(copies)[1]},                                      \
+  .size = sizeof((copies)[0]),                                              \
+}
+
+static inline void latch_write(latch_t *latch, const void *data) {
+  latch->seq++;
+  LATCH_BARRIER();
+  memcpy(latch->buf[0], data, latch->size);
+  LATCH_BARRIER();
+  latch->seq++;
+  LATCH_BARRIER();
+  memcpy(latch->buf[1], data, latch->size);
+}
+
+static inline void latch_read(const latch_t *latch, void *data) {
+  uint32_t seq;
+  do {
+    seq = latch->seq;
+    LATCH_BARRIER();
+    memcpy(data, latch->buf[seq & 1], latch->size);
+    LATCH_BARRIER();
+  } while (seq != latch->seq);
+}
+
+#endif /* LATCH_H */
+
+/** @} */
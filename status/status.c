@@ -0,0 +1,196 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file status.c
+ * @brief System status snapshot code.
+ * @details Each section of the snapshot has a single producer and is kept
+ *          in a latch, so /status readers never take a lock and never wait
+ *          on a preempted producer.
+ * @addtogroup STATUS
+ * @{
+ */
+
+#include <string.h>
+
+#include "ch.h"
+#include "hal.h"
+
+#include "lwip/opt.h"
+#include "lwip/netif.h"
+#include "lwip/memp.h"
+#include "lwip/stats.h"
+
+#include "cpu.h"
+#include "latch.h"
+#include "load.h"
+#include "series.h"
+#include "status.h"
+
+static status_system_t system_buf[2];
+static status_net_t net_buf[2];
+static status_app_t app_buf[2];
+
+static latch_t system_latch = LATCH_DATA(system_buf);
+static latch_t net_latch = LATCH_DATA(net_buf);
+static latch_t app_latch = LATCH_DATA(app_buf);
+
+#if MEMP_STATS
+/* stats_mem names only exist in debug builds, they come from the pool
+   list instead.*/
+static const char *const pool_names[MEMP_MAX] = {
+#define LWIP_MEMPOOL(name, num, size, desc) #name,
+#include "lwip/priv/memp_std.h"
+};
+#endif
+
+SERIES_DECL(heap_series, "heap", STATUS_SERIES_BLOCKS);
+SERIES_DECL(core_series, "core", STATUS_SERIES_BLOCKS);
+SERIES_DECL(load_series, "load", STATUS_SERIES_BLOCKS);
+
+/**
+ * @brief Broadcast after each sample of the status thread.
+ */
+EVENTSOURCE_DECL(status_event);
+
+static void status_sample_system(status_system_t *system) {
+  thread_t *tp;
+
+  system->time = chVTGetSystemTimeX();
+  system->heap_fragments = chHeapStatus(NULL, &system->heap_free,
+                                        &system->heap_largest);
+  system->core_free = chCoreGetStatusX();
+  load_read(system->load);
+
+  system->thread_count = 0;
+  tp = chRegFirstThread();
+  while (tp) {
+    if (system->thread_count < STATUS_THREADS) {
+      status_thread_t *thread = &system->threads[system->thread_count++];
+      strncpy(thread->name, tp->name ? tp->name : "", STATUS_NAME_SIZE - 1);
+      thread->name[STATUS_NAME_SIZE - 1] = '\0';
+      thread->prio = tp->prio;
+      thread->state = tp->state;
+      thread->cycles = tp->cpu_cycles;
+      for (int i = 0; i < CPU_LOADS; i++) {
+        thread->load[i] = CPU_PERMILLE(tp->cpu_load[i]);
+      }
+    }
+    tp = chRegNextThread(tp);
+  }
+}
+
+static void status_pool_add(status_net_t *net, const char *name,
+                            const struct stats_mem *mem) {
+  if (mem == NULL || net->pool_count >= STATUS_POOLS) {
+    return;
+  }
+  status_pool_t *pool = &net->pools[net->pool_count++];
+  pool->name = name;
+  pool->avail = mem->avail;
+  pool->used = mem->used;
+  pool->max = mem->max;
+  pool->err = mem->err;
+}
+
+static void status_sample_net(status_net_t *net) {
+  struct netif *netif = netif_default;
+
+  net->time = chVTGetSystemTimeX();
+  net->link = netif && netif_is_link_up(netif);
+  net->up = netif && netif_is_up(netif);
+  net->address = netif ? ip4_addr_get_u32(netif_ip4_addr(netif)) : 0;
+
+  net->pool_count = 0;
+#if MEM_STATS
+  status_pool_add(net, "HEAP", &lwip_stats.mem);
+#endif
+#if MEMP_STATS
+  for (int i = 0; i < MEMP_MAX; i++) {
+    status_pool_add(net, pool_names[i], lwip_stats.memp[i]);
+  }
+#endif
+}
+
+/**
+ * @brief Publishes the system section, producer is the status thread.
+ */
+void status_publish_system(const status_system_t *system) {
+  latch_write(&system_latch, system);
+}
+
+/**
+ * @brief Publishes the network section, producer is the status thread.
+ */
+void status_publish_net(const status_net_t *net) {
+  latch_write(&net_latch, net);
+}
+
+/**
+ * @brief Publishes the application section, producer is the web server.
+ */
+void status_publish_app(const status_app_t *app) {
+  latch_write(&app_latch, app);
+}
+
+/**
+ * @brief Copies a consistent snapshot of every section into @p status.
+ * @note  Lock free, it can be called from any thread.
+ */
+void status_read(status_t *status) {
+  latch_read(&system_latch, &status->system);
+  latch_read(&net_latch, &status->net);
+  latch_read(&app_latch, &status->app);
+}
+
+THD_WORKING_AREA(wa_status, STATUS_THREAD_STACK_SIZE);
+
+THD_FUNCTION(status_thread, p) {
+  static status_system_t system;
+  static status_net_t net;
+
+  (void)p;
+  chRegSetThreadName("status");
+
+  series_register(&heap_series);
+  series_register(&core_series);
+  series_register(&load_series);
+
+  while (true) {
+    bool window;
+
+    cpu_window();
+    window = load_window();
+    status_sample_system(&system);
+    status_publish_system(&system);
+
+    uint32_t now = series_now();
+    series_append(&heap_series, now, (float)system.heap_free);
+    series_append(&core_series, now, (float)system.core_free);
+    if (window) {
+      series_append(&load_series, now, system.load[0] / 10.0f);
+    }
+
+    status_sample_net(&net);
+    status_publish_net(&net);
+
+    chEvtBroadcast(&status_event);
+
+    chThdSleepMilliseconds(STATUS_PERIOD_MS);
+  }
+}
+
+/** @} */
@@ -0,0 +1,123 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file status.h
+ * @brief System status snapshot macros and structures.
+ * @addtogroup STATUS
+ * @{
+ */
+
+#ifndef STATUS_H
+#define STATUS_H
+
+#ifndef STATUS_THREAD_STACK_SIZE
+#define STATUS_THREAD_STACK_SIZE    512
+#endif
+
+#ifndef STATUS_THREAD_PRIORITY
+#define STATUS_THREAD_PRIORITY      (LOWPRIO + 2)
+#endif
+
+#ifndef STATUS_PERIOD_MS
+#define STATUS_PERIOD_MS            500
+#endif
+
+#ifndef STATUS_THREADS
+#define STATUS_THREADS              12
+#endif
+
+#ifndef STATUS_POOLS
+#define STATUS_POOLS                16
+#endif
+
+#ifndef STATUS_NAME_SIZE
+#define STATUS_NAME_SIZE            16
+#endif
+
+/**
+ * @brief Compressed blocks kept in each status time series, a power of two.
+ */
+#ifndef STATUS_SERIES_BLOCKS
+#define STATUS_SERIES_BLOCKS        16
+#endif
+
+typedef struct status_thread {
+  char name[STATUS_NAME_SIZE];
+  tprio_t prio;
+  tstate_t state;
+  uint64_t cycles;
+  uint16_t load[3];             /* Permille over 1 s, 10 s and 60 s.*/
+} status_thread_t;
+
+typedef struct status_system {
+  systime_t time;
+  size_t heap_free;
+  size_t heap_largest;
+  size_t heap_fragments;
+  size_t core_free;
+  uint16_t load[3];             /* Permille over 1 s, 10 s and 60 s.*/
+  int thread_count;
+  status_thread_t threads[STATUS_THREADS];
+} status_system_t;
+
+typedef struct status_pool {
+  const char *name;
+  uint16_t avail;
+  uint16_t used;
+  uint16_t max;
+  uint16_t err;
+} status_pool_t;
+
+typedef struct status_net {
+  systime_t time;
+  bool link;
+  bool up;
+  uint32_t address;
+  int pool_count;
+  status_pool_t pools[STATUS_POOLS];
+} status_net_t;
+
+typedef struct status_app {
+  systime_t time;
+  uint32_t requests;
+  char user[STATUS_NAME_SIZE];
+} status_app_t;
+
+typedef struct status {
+  status_system_t system;
+  status_net_t net;
+  status_app_t app;
+} status_t;
+
+extern THD_WORKING_AREA(wa_status, STATUS_THREAD_STACK_SIZE);
+extern event_source_t status_event;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  THD_FUNCTION(status_thread, p);
+  void status_publish_system(const status_system_t *system);
+  void status_publish_net(const status_net_t *net);
+  void status_publish_app(const status_app_t *app);
+  void status_read(status_t *status);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STATUS_H */
+
+/** @} */
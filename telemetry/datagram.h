@@ -0,0 +1,58 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file datagram.h
+ * @brief UDP telemetry wire format.
+ * @details Only depends on stdint.h, host side receivers include it as is.
+ * @addtogroup TELEMETRY
+ * @{
+ */
+
+#ifndef DATAGRAM_H
+#define DATAGRAM_H
+
+#include <stdint.h>
+
+#define TELEMETRY_MAGIC             0x314D4C54 /* "TLM1" */
+
+#define TELEMETRY_CHANNELS          4
+
+/**
+ * @brief Datagram header, all fields little endian.
+ * @details Followed by @p count records of a 16 bit offset from @p time
+ *          and @p channels 32 bit values: heap fragments, heap free,
+ *          heap largest block and core free, the heap channels are
+ *          refreshed at TELEMETRY_HEAP_HZ. Times are system ticks of
+ *          @p frequency Hz, gaps in @p seq are lost datagrams.
+ */
+typedef struct __attribute__((packed)) telemetry_header {
+  uint32_t magic;
+  uint32_t seq;
+  uint32_t time;
+  uint32_t frequency;
+  uint8_t channels;
+  uint8_t count;
+} telemetry_header_t;
+
+typedef struct __attribute__((packed)) telemetry_record {
+  uint16_t offset;
+  uint32_t values[TELEMETRY_CHANNELS];
+} telemetry_record_t;
+
+#endif /* DATAGRAM_H */
+
+/** @} */
@@ -0,0 +1,240 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file telemetry.c
+ * @brief UDP telemetry publisher code.
+ * @details Samples are taken at a fixed rate and batched into binary
+ *          datagrams pushed to the collector, there is no request to parse
+ *          and nothing is formatted as text.
+ * @addtogroup TELEMETRY
+ * @{
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ch.h"
+#include "hal.h"
+#include "chprintf.h"
+#include "shell.h"
+
+#include "lwip/opt.h"
+#include "lwip/api.h"
+
+#include "telemetry.h"
+#include "net.h"
+
+#if LWIP_NETCONN && LWIP_UDP
+
+typedef struct telemetry_datagram {
+  telemetry_header_t header;
+  telemetry_record_t records[TELEMETRY_BATCH];
+} __attribute__((packed)) telemetry_datagram_t;
+
+static telemetry_datagram_t datagram;
+
+static uint32_t heap_values[3];
+
+static unsigned heap_countdown;
+
+/**
+ * @brief Collector, any address stops the publisher.
+ * @details Written by the shell, the telemetry thread picks it up on the
+ *          next sample when @p collector_version changes, or at once when
+ *          it is stopped. The netconn is only touched by that thread.
+ */
+static ip_addr_t collector_address;
+static uint16_t collector_port = TELEMETRY_PORT;
+static uint32_t collector_version = 1;
+
+/* Signalled on each change, the stopped thread sleeps on it.*/
+static BSEMAPHORE_DECL(collector_changed, true);
+
+static void telemetry_sample(telemetry_record_t *record) {
+  if (heap_countdown == 0) {
+    size_t heap_free, heap_largest;
+
+    heap_values[0] = chHeapStatus(NULL, &heap_free, &heap_largest);
+    heap_values[1] = heap_free;
+    heap_values[2] = heap_largest;
+    heap_countdown = TELEMETRY_SAMPLE_HZ / TELEMETRY_HEAP_HZ;
+  }
+  heap_countdown--;
+
+  record->values[0] = heap_values[0];
+  record->values[1] = heap_values[1];
+  record->values[2] = heap_values[2];
+  record->values[3] = chCoreGetStatusX();
+}
+
+static void telemetry_send(struct netconn *conn, struct netbuf *buf) {
+  size_t len = sizeof(telemetry_header_t) +
+               datagram.header.count * sizeof(telemetry_record_t);
+
+  /* A full queue or a missing ARP entry only loses this batch, the
+     collector sees the gap in the sequence numbers.*/
+  if (netbuf_ref(buf, &datagram, len) == ERR_OK) {
+    netconn_send(conn, buf);
+  }
+  datagram.header.seq++;
+  datagram.header.count = 0;
+}
+
+/**
+ * @brief Picks up a new collector, returns false while stopped.
+ */
+static bool telemetry_connect(struct netconn *conn, uint32_t *version) {
+  ip_addr_t address;
+  uint16_t port;
+
+  chSysLock();
+  if (*version == collector_version) {
+    chSysUnlock();
+    return !ip_addr_isany(&collector_address);
+  }
+  *version = collector_version;
+  ip_addr_copy(address, collector_address);
+  port = collector_port;
+  chSysUnlock();
+
+  if (ip_addr_isany(&address)) {
+    netconn_disconnect(conn);
+    return false;
+  }
+  netconn_connect(conn, &address, port);
+  return true;
+}
+
+/**
+ * @brief Sets the collector, "off" stops publishing.
+ * @return False if @p address does not parse.
+ */
+bool telemetry_collector_set(const char *address, uint16_t port) {
+  ip_addr_t parsed;
+
+  if (strcmp(address, "off") == 0) {
+    ip_addr_set_zero(&parsed);
+  }
+  else if (!ipaddr_aton(address, &parsed)) {
+    return false;
+  }
+
+  chSysLock();
+  ip_addr_copy(collector_address, parsed);
+  collector_port = port;
+  collector_version++;
+  chBSemSignalI(&collector_changed);
+  chSchRescheduleS();
+  chSysUnlock();
+  return true;
+}
+
+THD_WORKING_AREA(wa_telemetry, TELEMETRY_THREAD_STACK_SIZE);
+
+THD_FUNCTION(telemetry_thread, p) {
+  struct netconn *conn;
+  struct netbuf *buf;
+  uint32_t version = 0;
+  systime_t next;
+
+  (void)p;
+  chRegSetThreadName("telemetry");
+
+  chSysLock();
+  TELEMETRY_COLLECTOR(&collector_address);
+  chSysUnlock();
+
+  net_wait();
+  conn = netconn_new(NETCONN_UDP);
+  LWIP_ERROR("telemetry: invalid conn", (conn != NULL), chThdExit(MSG_RESET););
+  buf = netbuf_new();
+  LWIP_ERROR("telemetry: invalid buf", (buf != NULL), chThdExit(MSG_RESET););
+
+  datagram.header.magic = TELEMETRY_MAGIC;
+  datagram.header.seq = 0;
+  datagram.header.frequency = CH_CFG_ST_FREQUENCY;
+  datagram.header.channels = TELEMETRY_CHANNELS;
+  datagram.header.count = 0;
+
+  next = chVTGetSystemTime();
+  while (true) {
+    telemetry_record_t *record;
+    systime_t now = chVTGetSystemTimeX();
+
+    if (!telemetry_connect(conn, &version)) {
+      /* Stopped, a pending batch is dropped and the thread sleeps until
+         a collector is set.*/
+      datagram.header.count = 0;
+      chBSemWait(&collector_changed);
+      next = chVTGetSystemTime();
+      continue;
+    }
+
+    if (datagram.header.count > 0 &&
+        chTimeDiffX(datagram.header.time, now) > 0xFFFF) {
+      /* Offsets are 16 bits wide.*/
+      telemetry_send(conn, buf);
+    }
+    if (datagram.header.count == 0) {
+      datagram.header.time = now;
+    }
+
+    record = &datagram.records[datagram.header.count++];
+    record->offset = (uint16_t)chTimeDiffX(datagram.header.time, now);
+    telemetry_sample(record);
+
+    if (datagram.header.count == TELEMETRY_BATCH) {
+      telemetry_send(conn, buf);
+    }
+
+    next = chThdSleepUntilWindowed(next,
+                                   chTimeAddX(next, TIME_US2I(1000000 /
+                                                      TELEMETRY_SAMPLE_HZ)));
+  }
+}
+
+/**
+ * @brief Shell command, "telemetry [address [port]|off]" sets or prints
+ *        the collector.
+ */
+void cmd_telemetry(BaseSequentialStream *chp, int argc, char *argv[]) {
+  ip_addr_t collector;
+  char address[IPADDR_STRLEN_MAX];
+  uint16_t port = TELEMETRY_PORT;
+
+  if (argc > 2 || (argc == 2 && (port = atoi(argv[1])) == 0) ||
+      (argc >= 1 && !telemetry_collector_set(argv[0], port))) {
+    chprintf(chp, "Usage: telemetry [address [port]|off]" SHELL_NEWLINE_STR);
+    return;
+  }
+
+  chSysLock();
+  ip_addr_copy(collector, collector_address);
+  port = collector_port;
+  chSysUnlock();
+  if (ip_addr_isany(&collector)) {
+    chprintf(chp, "collector off" SHELL_NEWLINE_STR);
+  }
+  else {
+    ipaddr_ntoa_r(&collector, address, sizeof(address));
+    chprintf(chp, "collector %s:%u" SHELL_NEWLINE_STR, address, port);
+  }
+}
+
+#endif
+
+/** @} */
@@ -0,0 +1,83 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file telemetry.h
+ * @brief UDP telemetry publisher macros and structures.
+ * @addtogroup TELEMETRY
+ * @{
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "datagram.h"
+
+#ifndef TELEMETRY_THREAD_STACK_SIZE
+#define TELEMETRY_THREAD_STACK_SIZE 512
+#endif
+
+#ifndef TELEMETRY_THREAD_PRIORITY
+#define TELEMETRY_THREAD_PRIORITY   (LOWPRIO + 1)
+#endif
+
+/**
+ * @brief Collector address at boot, same form as LWIP_IPADDR.
+ * @details The default 0.0.0.0 (IP_ADDR_ANY) leaves the publisher off
+ *          until a collector is set with telemetry_collector_set().
+ */
+#ifndef TELEMETRY_COLLECTOR
+#define TELEMETRY_COLLECTOR(p)      IP4_ADDR(p, 0, 0, 0, 0)
+#endif
+
+#ifndef TELEMETRY_PORT
+#define TELEMETRY_PORT              5005
+#endif
+
+#ifndef TELEMETRY_SAMPLE_HZ
+#define TELEMETRY_SAMPLE_HZ         1000
+#endif
+
+/**
+ * @brief Rate of the heap channels, walking the free list takes the heap
+ *        mutex. Records in between repeat the last values.
+ */
+#ifndef TELEMETRY_HEAP_HZ
+#define TELEMETRY_HEAP_HZ           10
+#endif
+
+/**
+ * @brief Samples per datagram, at most 255.
+ */
+#ifndef TELEMETRY_BATCH
+#define TELEMETRY_BATCH             50
+#endif
+
+extern THD_WORKING_AREA(wa_telemetry, TELEMETRY_THREAD_STACK_SIZE);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  THD_FUNCTION(telemetry_thread, p);
+  bool telemetry_collector_set(const char *address, uint16_t port);
+  void cmd_telemetry(BaseSequentialStream *chp, int argc, char *argv[]);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TELEMETRY_H */
+
+/** @} */
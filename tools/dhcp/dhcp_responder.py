@@ -0,0 +1,197 @@
+#!/usr/bin/env python3
+"""
+Scripted DHCP server standing in for the real one, to walk the board through
+each path of its DHCP client on a bench network:
+
+  INIT-REBOOT     a DHCPREQUEST for the cached lease, no server identifier,
+                  answered as told by --reboot (ack, nak or silent)
+  fallback        after a DHCPNAK or no answer the board discovers, offers
+                  and requests are always answered
+  Rapid Commit    with --rapid-commit a DHCPDISCOVER carrying option 80 gets
+                  a DHCPACK straight away (RFC 4039)
+
+--reboot takes a list, one entry per INIT-REBOOT request, the last one
+repeats: "--reboot silent,nak,ack". Every exchange is logged with the time
+from the request to the answer, the board's /boot "address" stage gives
+the same round trip from its side.
+
+  sudo ./dhcp_responder.py --server 192.168.1.1 --address 192.168.1.100
+
+Run it on an isolated segment, it answers every client.
+"""
+
+import argparse
+import ipaddress
+import socket
+import struct
+import sys
+import time
+
+MAGIC = b"\x63\x82\x53\x63"
+
+DISCOVER, OFFER, REQUEST, DECLINE, ACK, NAK, RELEASE, INFORM = range(1, 9)
+
+NAMES = {DISCOVER: "DISCOVER", OFFER: "OFFER", REQUEST: "REQUEST",
+         DECLINE: "DECLINE", ACK: "ACK", NAK: "NAK", RELEASE: "RELEASE",
+         INFORM: "INFORM"}
+
+OPT_PAD, OPT_MASK, OPT_ROUTER, OPT_DNS = 0, 1, 3, 6
+OPT_REQUESTED, OPT_LEASE, OPT_TYPE, OPT_SERVER = 50, 51, 53, 54
+OPT_T1, OPT_T2, OPT_RAPID_COMMIT, OPT_END = 58, 59, 80, 255
+
+HEADER = struct.Struct("!BBBBIHH4s4s4s4s16s64s128s")
+
+
+def parse(data):
+    """Returns the BOOTP fields and the options of a client message."""
+    if (len(data) < HEADER.size + 4 or
+            data[HEADER.size:HEADER.size + 4] != MAGIC):
+        return None
+    (op, htype, hlen, _, xid, _, flags, ciaddr, _, _, giaddr, chaddr,
+     _, _) = HEADER.unpack_from(data)
+    if op != 1:
+        return None
+    options = {}
+    i = HEADER.size + 4
+    while i < len(data):
+        code = data[i]
+        if code == OPT_PAD:
+            i += 1
+            continue
+        if code == OPT_END or i + 1 >= len(data):
+            break
+        length = data[i + 1]
+        options[code] = data[i + 2:i + 2 + length]
+        i += 2 + length
+    return {"xid": xid, "flags": flags, "ciaddr": ciaddr, "giaddr": giaddr,
+            "chaddr": chaddr, "hlen": hlen, "htype": htype,
+            "options": options}
+
+
+def build(message, kind, yiaddr, server, extra=()):
+    """Builds a server reply, the message type first as lwIP expects."""
+    head = HEADER.pack(2, message["htype"], message["hlen"], 0,
+                       message["xid"], 0, message["flags"],
+                       message["ciaddr"] if kind == ACK else bytes(4),
+                       yiaddr, bytes(4), message["giaddr"],
+                       message["chaddr"], bytes(64), bytes(128))
+    options = [(OPT_TYPE, bytes([kind])), (OPT_SERVER, server)]
+    options.extend(extra)
+    body = b"".join(bytes([code, len(value)]) + value
+                    for code, value in options)
+    return head + MAGIC + body + bytes([OPT_END])
+
+
+class Responder:
+    def __init__(self, args):
+        self.server = ipaddress.IPv4Address(args.server).packed
+        self.address = ipaddress.IPv4Address(args.address).packed
+        self.lease = args.lease
+        self.reboot = args.reboot
+        self.rapid_commit = args.rapid_commit
+        self.reboots = 0
+        net = ipaddress.IPv4Network(f"{args.server}/{args.prefix}",
+                                    strict=False)
+        self.config = [(OPT_MASK, net.netmask.packed),
+                       (OPT_ROUTER, self.server),
+                       (OPT_DNS, self.server),
+                       (OPT_LEASE, struct.pack("!I", self.lease)),
+                       (OPT_T1, struct.pack("!I", self.lease // 2)),
+                       (OPT_T2, struct.pack("!I", self.lease * 7 // 8))]
+
+    def answer(self, message):
+        """Returns (reply type or None, label) for a client message."""
+        options = message["options"]
+        kind = options.get(OPT_TYPE, b"\0")[0]
+        if kind == DISCOVER:
+            if self.rapid_commit and OPT_RAPID_COMMIT in options:
+                return ACK, "DISCOVER rapid commit"
+            return OFFER, "DISCOVER"
+        if kind != REQUEST:
+            return None, NAMES.get(kind, str(kind))
+        if OPT_SERVER in options:
+            if options[OPT_SERVER] != self.server:
+                return None, "REQUEST for another server"
+            return ACK, "REQUEST selecting"
+        if message["ciaddr"] != bytes(4):
+            return ACK, "REQUEST renewing"
+        # INIT-REBOOT, RFC 2131 4.3.2: NAK a wrong address, else scripted.
+        action = self.reboot[min(self.reboots, len(self.reboot) - 1)]
+        self.reboots += 1
+        if options.get(OPT_REQUESTED) != self.address:
+            action = "nak"
+        label = "REQUEST init-reboot %s" % ipaddress.IPv4Address(
+            options.get(OPT_REQUESTED, bytes(4)))
+        return {"ack": ACK, "nak": NAK, "silent": None}[action], label
+
+    def reply(self, message):
+        """Returns (reply bytes or None, label)."""
+        kind, label = self.answer(message)
+        if kind is None:
+            return None, label
+        if kind == NAK:
+            return build(message, NAK, bytes(4), self.server), label
+        extra = list(self.config)
+        if kind == ACK and "rapid commit" in label:
+            extra.insert(0, (OPT_RAPID_COMMIT, b""))
+        return build(message, kind, self.address, self.server, extra), label
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(
+        description=__doc__, formatter_class=argparse.RawTextHelpFormatter)
+    parser.add_argument("--server", required=True,
+                        help="address of this host, the server identifier")
+    parser.add_argument("--address", required=True,
+                        help="address leased to the board")
+    parser.add_argument("--prefix", type=int, default=24)
+    parser.add_argument("--lease", type=int, default=3600,
+                        help="lease time in seconds")
+    parser.add_argument("--reboot", default="ack",
+                        type=lambda s: s.split(","),
+                        help="answers to INIT-REBOOT: ack, nak, silent")
+    parser.add_argument("--rapid-commit", action="store_true",
+                        help="ACK a DISCOVER carrying option 80")
+    parser.add_argument("--bind", default="0.0.0.0")
+    parser.add_argument("--port", type=int, default=67)
+    parser.add_argument("--client-port", type=int, default=68)
+    parser.add_argument("--reply-to", default="255.255.255.255",
+                        help="replies are broadcast, the board has no "
+                             "address yet")
+    parser.add_argument("--count", type=int, default=0,
+                        help="exit after this many messages, 0 runs forever")
+    args = parser.parse_args(argv)
+    for action in args.reboot:
+        if action not in ("ack", "nak", "silent"):
+            parser.error("--reboot takes ack, nak and silent")
+
+    responder = Responder(args)
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_BROADCAST, 1)
+    sock.bind((args.bind, args.port))
+    print("listening on %s:%d" % (args.bind, args.port))
+    sys.stdout.flush()
+
+    seen = 0
+    while args.count == 0 or seen < args.count:
+        data, _ = sock.recvfrom(1500)
+        start = time.monotonic()
+        message = parse(data)
+        if message is None:
+            continue
+        seen += 1
+        reply, label = responder.reply(message)
+        mac = message["chaddr"][:message["hlen"]].hex(":")
+        if reply is None:
+            print("%s xid %08x %s -> no answer" % (mac, message["xid"], label))
+        else:
+            sock.sendto(reply, (args.reply_to, args.client_port))
+            print("%s xid %08x %s -> %s in %.3f ms" %
+                  (mac, message["xid"], label, NAMES[reply[HEADER.size + 6]],
+                   (time.monotonic() - start) * 1000))
+        sys.stdout.flush()
+
+
+if __name__ == "__main__":
+    main()
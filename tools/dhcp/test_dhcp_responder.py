@@ -0,0 +1,175 @@
+#!/usr/bin/env python3
+"""
+Drives dhcp_responder.py over loopback with the messages the board's lwIP
+client sends, one test per path of net.c:
+
+  INIT-REBOOT     net_dhcp_start() puts the client in REBOOTING, the link up
+                  sends a REQUEST with option 50 only, ACKed in one round trip
+  fallback        a NAK or no answer makes lwIP discover, OFFER then ACK
+  Rapid Commit    a DISCOVER with option 80 is ACKed with option 80 after
+                  the message type, net_dhcp_parse_option() moves the client
+                  to REQUESTING and takes the server identifier
+
+  python3 test_dhcp_responder.py
+"""
+
+import os
+import socket
+import subprocess
+import sys
+import unittest
+
+import dhcp_responder as dr
+
+SERVER = "127.0.0.1"
+LEASED = bytes([192, 168, 1, 100])
+MAC = bytes.fromhex("020000000001") + bytes(10)
+
+
+def free_port():
+    with socket.socket(socket.AF_INET, socket.SOCK_DGRAM) as s:
+        s.bind(("127.0.0.1", 0))
+        return s.getsockname()[1]
+
+
+def request(kind, xid, options, ciaddr=bytes(4)):
+    """A client message laid out as lwIP's dhcp_create_msg() does."""
+    head = dr.HEADER.pack(1, 1, 6, 0, xid, 0, 0, ciaddr, bytes(4), bytes(4),
+                          bytes(4), MAC, bytes(64), bytes(128))
+    body = bytes([dr.OPT_TYPE, 1, kind, 57, 2, 0x05, 0xdc])
+    for code, value in options:
+        body += bytes([code, len(value)]) + value
+    body += bytes([55, 4, 1, 3, 6, 15, dr.OPT_END])
+    return head + dr.MAGIC + body
+
+
+def options(data):
+    """Option codes in order and their values."""
+    order, values = [], {}
+    i = dr.HEADER.size + 4
+    while data[i] != dr.OPT_END:
+        order.append(data[i])
+        values[data[i]] = data[i + 2:i + 2 + data[i + 1]]
+        i += 2 + data[i + 1]
+    return order, values
+
+
+class ResponderTest(unittest.TestCase):
+    def start(self, *extra):
+        self.server_port = free_port()
+        self.client = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.client.bind(("127.0.0.1", 0))
+        self.client.settimeout(0.5)
+        here = os.path.dirname(os.path.abspath(__file__))
+        self.process = subprocess.Popen(
+            [sys.executable, os.path.join(here, "dhcp_responder.py"),
+             "--server", SERVER, "--address", "192.168.1.100",
+             "--bind", "127.0.0.1", "--port", str(self.server_port),
+             "--reply-to", "127.0.0.1",
+             "--client-port", str(self.client.getsockname()[1])] +
+            list(extra), stdout=subprocess.PIPE, text=True)
+        self.addCleanup(self.stop)
+        self.assertIn("listening", self.process.stdout.readline())
+
+    def stop(self):
+        self.process.kill()
+        self.process.wait()
+        self.process.stdout.close()
+        self.client.close()
+
+    def exchange(self, message):
+        """Sends a message, returns the reply or None and the log line."""
+        self.client.sendto(message, ("127.0.0.1", self.server_port))
+        try:
+            reply = self.client.recv(1500)
+        except socket.timeout:
+            reply = None
+        return reply, self.process.stdout.readline().strip()
+
+    def assertReply(self, reply, kind, xid):
+        self.assertIsNotNone(reply)
+        fields = dr.HEADER.unpack_from(reply)
+        self.assertEqual(fields[0], 2)
+        self.assertEqual(fields[4], xid)
+        order, values = options(reply)
+        self.assertEqual(order[0], dr.OPT_TYPE, "lwIP needs the type first")
+        self.assertEqual(values[dr.OPT_TYPE], bytes([kind]))
+        self.assertEqual(values[dr.OPT_SERVER], socket.inet_aton(SERVER))
+        if kind != dr.NAK:
+            self.assertEqual(fields[8], LEASED)
+            self.assertIn(dr.OPT_LEASE, values)
+        return order, values
+
+    def reboot(self, xid, address=LEASED):
+        return request(dr.REQUEST, xid, [(dr.OPT_REQUESTED, address)])
+
+    def discover(self, xid, rapid_commit):
+        """With NET_DHCP_RAPID_COMMIT the board adds option 80."""
+        return self.exchange(request(
+            dr.DISCOVER, xid,
+            [(dr.OPT_RAPID_COMMIT, b"")] if rapid_commit else []))
+
+    def test_init_reboot_ack(self):
+        self.start("--reboot", "ack")
+        reply, log = self.exchange(self.reboot(0x1001))
+        order, _ = self.assertReply(reply, dr.ACK, 0x1001)
+        self.assertNotIn(dr.OPT_RAPID_COMMIT, order)
+        self.assertIn("init-reboot 192.168.1.100 -> ACK in", log)
+
+    def test_init_reboot_wrong_address(self):
+        self.start("--reboot", "ack")
+        reply, log = self.exchange(self.reboot(0x1002, bytes([10, 0, 0, 9])))
+        self.assertReply(reply, dr.NAK, 0x1002)
+        self.assertIn("-> NAK", log)
+
+    def test_nak_falls_back_to_discovery(self):
+        self.start("--reboot", "nak,ack")
+        reply, log = self.exchange(self.reboot(0x2001))
+        self.assertReply(reply, dr.NAK, 0x2001)
+        reply, log = self.discover(0x2002, rapid_commit=False)
+        self.assertReply(reply, dr.OFFER, 0x2002)
+        reply, log = self.exchange(request(
+            dr.REQUEST, 0x2002, [(dr.OPT_REQUESTED, LEASED),
+                                 (dr.OPT_SERVER, socket.inet_aton(SERVER))]))
+        self.assertReply(reply, dr.ACK, 0x2002)
+        self.assertIn("selecting -> ACK", log)
+        # The script moves on, the next reboot is ACKed.
+        reply, _ = self.exchange(self.reboot(0x2003))
+        self.assertReply(reply, dr.ACK, 0x2003)
+
+    def test_silent_falls_back_to_discovery(self):
+        self.start("--reboot", "silent")
+        reply, log = self.exchange(self.reboot(0x3001))
+        self.assertIsNone(reply)
+        self.assertIn("init-reboot 192.168.1.100 -> no answer", log)
+        # lwIP retries the REQUEST, then discovers.
+        reply, _ = self.exchange(self.reboot(0x3001))
+        self.assertIsNone(reply)
+        reply, _ = self.discover(0x3002, rapid_commit=False)
+        self.assertReply(reply, dr.OFFER, 0x3002)
+
+    def test_rapid_commit(self):
+        self.start("--rapid-commit")
+        reply, log = self.discover(0x4001, rapid_commit=True)
+        order, values = self.assertReply(reply, dr.ACK, 0x4001)
+        # net_dhcp_parse_option() sees option 80 after the type and
+        # net_dhcp_server() finds the identifier in the same message.
+        self.assertLess(order.index(dr.OPT_TYPE),
+                        order.index(dr.OPT_RAPID_COMMIT))
+        self.assertEqual(values[dr.OPT_RAPID_COMMIT], b"")
+        self.assertIn("rapid commit -> ACK", log)
+
+    def test_rapid_commit_needs_the_option(self):
+        self.start("--rapid-commit")
+        reply, _ = self.discover(0x4002, rapid_commit=False)
+        self.assertReply(reply, dr.OFFER, 0x4002)
+
+    def test_rapid_commit_off(self):
+        self.start()
+        reply, _ = self.discover(0x4003, rapid_commit=True)
+        order, _ = self.assertReply(reply, dr.OFFER, 0x4003)
+        self.assertNotIn(dr.OPT_RAPID_COMMIT, order)
+
+
+if __name__ == "__main__":
+    unittest.main()
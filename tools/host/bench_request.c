@@ -0,0 +1,176 @@
+/*
+ * Throughput of the request parser and of the JSON path on the corpus:
+ * requests per second and bytes per cycle (TSC cycles on x86, bytes per
+ * nanosecond elsewhere).
+ */
+
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "request.h"
+
+#if HAVE_JSMN
+#include "jsmn.h"
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CYCLES()        __rdtsc()
+#define CYCLES_UNIT     "cycle"
+#else
+#define CYCLES()        now_ns()
+#define CYCLES_UNIT     "ns"
+#endif
+
+#define INPUTS_MAX 256
+#define BENCH_SECONDS 1.0
+
+static header_t headers[HEADER_COUNT];
+
+static char header_names[HEADER_COUNT][HEADER_NAME_SIZE];
+
+static char header_values[HEADER_COUNT][HEADER_VALUE_SIZE];
+
+static char method[REQUEST_METHOD_SIZE];
+
+static char url[REQUEST_URL_SIZE];
+
+static char protocol[REQUEST_PROTOCOL_SIZE];
+
+static char body[REQUEST_BODY_SIZE];
+
+static char js[256];
+
+static request_t request = {
+  .method = method,
+  .url = url,
+  .protocol = protocol,
+  .body = body,
+};
+
+static char *inputs[INPUTS_MAX];
+
+static char *bodies[INPUTS_MAX];
+
+static int count;
+
+static int body_count;
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000U + (uint64_t)ts.tv_nsec;
+}
+
+static void load(const char *dir_path) {
+  DIR *dir = opendir(dir_path);
+  struct dirent *entry;
+  char name[1024];
+
+  if (dir == NULL) {
+    perror(dir_path);
+    exit(1);
+  }
+  while ((entry = readdir(dir)) != NULL && count < INPUTS_MAX) {
+    FILE *f;
+    size_t n;
+
+    if (entry->d_name[0] == '.') {
+      continue;
+    }
+    snprintf(name, sizeof(name), "%s/%s", dir_path, entry->d_name);
+    f = fopen(name, "rb");
+    if (f == NULL) {
+      continue;
+    }
+    inputs[count] = calloc(REQUEST_SIZE, 1);
+    n = fread(inputs[count], 1, REQUEST_SIZE - 1, f);
+    inputs[count][n] = '\0';
+    fclose(f);
+    count++;
+  }
+  closedir(dir);
+}
+
+static void json_path(const char *raw) {
+  json_get(js, sizeof(js), raw);
+#if HAVE_JSMN
+  {
+    jsmn_parser p;
+    jsmntok_t t[128];
+
+    jsmn_init(&p);
+    jsmn_parse(&p, js, strlen(js), t, sizeof(t) / sizeof(t[0]));
+  }
+#endif
+}
+
+/* Runs pass() until BENCH_SECONDS elapsed, reports per item figures.*/
+static void bench(const char *title, void (*pass)(void), int items,
+                  size_t bytes) {
+  uint64_t start = now_ns(), elapsed;
+  uint64_t c0 = CYCLES(), cycles;
+  long passes = 0;
+
+  do {
+    pass();
+    passes++;
+    elapsed = now_ns() - start;
+  } while (elapsed < (uint64_t)(BENCH_SECONDS * 1e9));
+  cycles = CYCLES() - c0;
+
+  printf("%-8s %10.0f req/s %8.3f bytes/%s %8.1f %s/req\n", title,
+         (double)passes * items / (elapsed / 1e9),
+         (double)passes * bytes / cycles, CYCLES_UNIT,
+         (double)cycles / ((double)passes * items), CYCLES_UNIT);
+}
+
+static void parse_pass(void) {
+  for (int i = 0; i < count; i++) {
+    request_parse(&request, headers, inputs[i]);
+  }
+}
+
+static void json_pass(void) {
+  for (int i = 0; i < body_count; i++) {
+    json_path(bodies[i]);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  size_t parse_bytes = 0, json_bytes = 0;
+
+  for (int i = 0; i < HEADER_COUNT; i++) {
+    headers[i].name = header_names[i];
+    headers[i].value = header_values[i];
+  }
+  for (int i = 1; i < argc; i++) {
+    load(argv[i]);
+  }
+  if (count == 0) {
+    fprintf(stderr, "usage: %s corpus...\n", argv[0]);
+    return 1;
+  }
+
+  for (int i = 0; i < count; i++) {
+    parse_bytes += strlen(inputs[i]);
+    if (request_parse(&request, headers, inputs[i]) && body[0] != '\0') {
+      bodies[body_count] = strdup(body);
+      json_bytes += strlen(body);
+      body_count++;
+    }
+  }
+
+  printf("%d requests, %zu bytes, %d bodies\n", count, parse_bytes,
+         body_count);
+  bench("parse", parse_pass, count, parse_bytes);
+  if (body_count > 0) {
+    bench("json", json_pass, body_count, json_bytes);
+  }
+  return 0;
+}
@@ -0,0 +1,72 @@
+/*
+ * libFuzzer target for the HTTP request parser and the JSON extraction,
+ * fed the same way as http_server_serve(): at most REQUEST_SIZE - 1 bytes
+ * of the raw request, NUL terminated.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "request.h"
+
+#if HAVE_JSMN
+#include "jsmn.h"
+#endif
+
+static header_t headers[HEADER_COUNT];
+
+static char header_names[HEADER_COUNT][HEADER_NAME_SIZE];
+
+static char header_values[HEADER_COUNT][HEADER_VALUE_SIZE];
+
+static char method[REQUEST_METHOD_SIZE];
+
+static char url[REQUEST_URL_SIZE];
+
+static char protocol[REQUEST_PROTOCOL_SIZE];
+
+static char body[REQUEST_BODY_SIZE];
+
+static char raw[REQUEST_SIZE];
+
+static char js[256];
+
+static char value[16];
+
+static request_t request;
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  if (size > REQUEST_SIZE - 1) {
+    size = REQUEST_SIZE - 1;
+  }
+  memcpy(raw, data, size);
+  raw[size] = '\0';
+
+  for (int i = 0; i < HEADER_COUNT; i++) {
+    headers[i].name = header_names[i];
+    headers[i].value = header_values[i];
+  }
+  request.method = method;
+  request.url = url;
+  request.protocol = protocol;
+  request.body = body;
+
+  if (!request_parse(&request, headers, raw)) {
+    return 0;
+  }
+  json_get(js, sizeof(js), request.body);
+  json_unescape(value, sizeof(value), js, strlen(js));
+
+#if HAVE_JSMN
+  {
+    jsmn_parser p;
+    jsmntok_t t[128];
+
+    jsmn_init(&p);
+    jsmn_parse(&p, js, strlen(js), t, sizeof(t) / sizeof(t[0]));
+  }
+#endif
+  return 0;
+}
@@ -0,0 +1,140 @@
+/*
+ * Standalone driver for fuzz_request.c where libFuzzer is not available:
+ * runs every file given on the command line once and, with -n N, N random
+ * mutations of them. Build it with ASan/UBSan, see the Makefile.
+ */
+
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define INPUT_SIZE 2048
+#define INPUTS_MAX 256
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+static uint8_t *inputs[INPUTS_MAX];
+
+static size_t sizes[INPUTS_MAX];
+
+static int count;
+
+static void load(const char *path) {
+  struct stat st;
+
+  if (stat(path, &st) != 0) {
+    perror(path);
+    exit(1);
+  }
+  if (S_ISDIR(st.st_mode)) {
+    DIR *dir = opendir(path);
+    struct dirent *entry;
+    char name[1024];
+
+    while (dir != NULL && (entry = readdir(dir)) != NULL) {
+      if (entry->d_name[0] != '.') {
+        snprintf(name, sizeof(name), "%s/%s", path, entry->d_name);
+        load(name);
+      }
+    }
+    if (dir != NULL) {
+      closedir(dir);
+    }
+    return;
+  }
+
+  FILE *f = fopen(path, "rb");
+  if (f == NULL || count >= INPUTS_MAX) {
+    perror(path);
+    exit(1);
+  }
+  inputs[count] = malloc(INPUT_SIZE);
+  sizes[count] = fread(inputs[count], 1, INPUT_SIZE, f);
+  fclose(f);
+  count++;
+}
+
+/* Byte flips, interesting bytes, truncation and splices.*/
+static size_t mutate(uint8_t *buf, size_t size) {
+  static const uint8_t special[] = {'\0', '\r', '\n', ' ', ':', '?', '{',
+                                    '}', '"', '\\', 0xff};
+  int edits = 1 + rand() % 8;
+
+  for (int i = 0; i < edits; i++) {
+    size_t at = size ? (size_t)rand() % size : 0;
+
+    switch (rand() % 5) {
+    case 0:
+      if (size) {
+        buf[at] ^= (uint8_t)(1U << (rand() % 8));
+      }
+      break;
+    case 1:
+      if (size) {
+        buf[at] = special[rand() % sizeof(special)];
+      }
+      break;
+    case 2:
+      size = at;
+      break;
+    case 3: {
+      /* Repeats a run, stretches tokens past their buffers.*/
+      size_t len = 1 + (size_t)rand() % 256;
+
+      if (at + len <= size && size + len <= INPUT_SIZE) {
+        memmove(buf + at + len, buf + at, size - at);
+        size += len;
+      }
+      break;
+    }
+    default: {
+      int other = rand() % count;
+      size_t len = sizes[other] ? (size_t)rand() % sizes[other] : 0;
+
+      if (at + len <= INPUT_SIZE) {
+        memcpy(buf + at, inputs[other], len);
+        if (at + len > size) {
+          size = at + len;
+        }
+      }
+      break;
+    }
+    }
+  }
+  return size;
+}
+
+int main(int argc, char *argv[]) {
+  long runs = 0;
+  uint8_t buf[INPUT_SIZE];
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+      runs = atol(argv[++i]);
+    } else {
+      load(argv[i]);
+    }
+  }
+  if (count == 0) {
+    fprintf(stderr, "usage: %s [-n runs] corpus...\n", argv[0]);
+    return 1;
+  }
+
+  for (int i = 0; i < count; i++) {
+    LLVMFuzzerTestOneInput(inputs[i], sizes[i]);
+  }
+  srand(1);
+  for (long n = 0; n < runs; n++) {
+    int i = rand() % count;
+    size_t size;
+
+    memcpy(buf, inputs[i], sizes[i]);
+    size = mutate(buf, sizes[i]);
+    LLVMFuzzerTestOneInput(buf, size);
+  }
+  printf("%d inputs, %ld mutations\n", count, runs);
+  return 0;
+}
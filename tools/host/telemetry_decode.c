@@ -0,0 +1,61 @@
+/*
+ * Decoder for the telemetry datagrams, see telemetry_decode.h.
+ */
+
+#include "telemetry_decode.h"
+#include "datagram.h"
+
+static uint32_t get16(const uint8_t *p) {
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8;
+}
+
+static uint32_t get32(const uint8_t *p) {
+  return get16(p) | get16(p + 2) << 16;
+}
+
+int decode_datagram(decode_state_t *state, const uint8_t *data, size_t len,
+                    decode_emit_t emit, void *ctx) {
+  decode_sample_t sample;
+  uint32_t time;
+  unsigned count;
+  size_t record_size;
+
+  if (len < DECODE_HEADER_SIZE || get32(data) != TELEMETRY_MAGIC) {
+    state->rejected++;
+    return -1;
+  }
+  sample.seq = get32(data + 4);
+  time = get32(data + 8);
+  sample.frequency = get32(data + 12);
+  sample.channels = data[16];
+  count = data[17];
+  record_size = 2 + 4 * (size_t)sample.channels;
+  if (sample.frequency == 0 ||
+      len != DECODE_HEADER_SIZE + count * record_size) {
+    state->rejected++;
+    return -1;
+  }
+
+  /* Datagrams are not retransmitted, a jump forward is a loss. Anything
+     else restarts the count, the target rebooted.*/
+  if (state->started && sample.seq != state->next_seq &&
+      sample.seq - state->next_seq < 0x80000000u) {
+    state->lost += sample.seq - state->next_seq;
+  }
+  state->started = 1;
+  state->next_seq = sample.seq + 1;
+  state->datagrams++;
+
+  data += DECODE_HEADER_SIZE;
+  for (unsigned i = 0; i < count; i++, data += record_size) {
+    sample.time = time + get16(data);
+    for (unsigned c = 0; c < sample.channels; c++) {
+      sample.values[c] = get32(data + 2 + 4 * c);
+    }
+    state->samples++;
+    if (emit != NULL) {
+      emit(ctx, &sample);
+    }
+  }
+  return (int)count;
+}
@@ -0,0 +1,43 @@
+/*
+ * Decoder for the telemetry datagrams, see telemetry/datagram.h. Reads the
+ * fields byte by byte as little endian rather than through the packed
+ * structs, so a test encoding with the structs checks the layout too.
+ */
+
+#ifndef TELEMETRY_DECODE_H
+#define TELEMETRY_DECODE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define DECODE_HEADER_SIZE      18
+#define DECODE_CHANNELS_MAX     255
+
+typedef struct decode_sample {
+  uint32_t seq;
+  uint32_t time;                /* Header time plus offset, wraps.*/
+  uint32_t frequency;
+  unsigned channels;
+  uint32_t values[DECODE_CHANNELS_MAX];
+} decode_sample_t;
+
+typedef struct decode_state {
+  int started;
+  uint32_t next_seq;
+  uint32_t datagrams;
+  uint32_t samples;
+  uint32_t lost;                /* Datagrams missing from the sequence.*/
+  uint32_t rejected;            /* Bad magic or size.*/
+} decode_state_t;
+
+typedef void (*decode_emit_t)(void *ctx, const decode_sample_t *sample);
+
+/*
+ * Decodes one datagram, calling emit for each record. Returns the number of
+ * records or -1 if the datagram is rejected, which emits nothing and
+ * leaves the sequence alone.
+ */
+int decode_datagram(decode_state_t *state, const uint8_t *data, size_t len,
+                    decode_emit_t emit, void *ctx);
+
+#endif /* TELEMETRY_DECODE_H */
@@ -0,0 +1,67 @@
+/*
+ * Telemetry collector: listens on a UDP port and prints the samples as CSV,
+ * seq,seconds,values... on stdout. Lost and rejected datagrams go to stderr.
+ *
+ *   ./telemetry_rx [port]
+ *
+ * then point the board at this host with "telemetry <address> [port]".
+ */
+
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "telemetry_decode.h"
+
+static void print_sample(void *ctx, const decode_sample_t *sample) {
+  (void)ctx;
+  printf("%u,%.6f", sample->seq, (double)sample->time / sample->frequency);
+  for (unsigned c = 0; c < sample->channels; c++) {
+    printf(",%u", sample->values[c]);
+  }
+  printf("\n");
+}
+
+int main(int argc, char *argv[]) {
+  struct sockaddr_in addr;
+  decode_state_t state = {0};
+  uint8_t data[65536];
+  int fd;
+
+  if (argc > 2) {
+    fprintf(stderr, "usage: %s [port]\n", argv[0]);
+    return 2;
+  }
+
+  fd = socket(AF_INET, SOCK_DGRAM, 0);
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(argc == 2 ? atoi(argv[1]) : 5005);
+  if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+    perror("bind");
+    return 1;
+  }
+
+  while (1) {
+    uint32_t lost = state.lost, rejected = state.rejected;
+    ssize_t len = recv(fd, data, sizeof(data), 0);
+
+    if (len < 0) {
+      perror("recv");
+      return 1;
+    }
+    decode_datagram(&state, data, (size_t)len, print_sample, NULL);
+    fflush(stdout);
+    if (state.lost != lost) {
+      fprintf(stderr, "lost %u datagrams before seq %u\n",
+              state.lost - lost, state.next_seq - 1);
+    }
+    if (state.rejected != rejected) {
+      fprintf(stderr, "rejected a %zd byte datagram\n", len);
+    }
+  }
+}
@@ -0,0 +1,186 @@
+/*
+ * Round trip of the telemetry datagrams through a local UDP socket: the
+ * sender lays them out with the structs of telemetry/datagram.h, the same
+ * way the target does, and the decoder reads them back. Covers the header,
+ * gaps in the sequence, 16 bit offsets across a wrap of the tick counter
+ * and rejected datagrams.
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "datagram.h"
+#include "telemetry_decode.h"
+
+#define BATCH 50
+
+typedef struct datagram {
+  telemetry_header_t header;
+  telemetry_record_t records[BATCH];
+} __attribute__((packed)) datagram_t;
+
+static int failures;
+
+#define CHECK(c)                                                            \
+  do {                                                                      \
+    if (!(c)) {                                                             \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #c);\
+      failures++;                                                           \
+    }                                                                       \
+  } while (0)
+
+static int tx, rx;
+
+static decode_sample_t samples[BATCH];
+
+static unsigned emitted;
+
+static void collect(void *ctx, const decode_sample_t *sample) {
+  (void)ctx;
+  if (emitted < BATCH) {
+    samples[emitted] = *sample;
+  }
+  emitted++;
+}
+
+/* Sends len bytes of d over the socket pair and decodes what arrives.*/
+static int roundtrip(decode_state_t *state, const void *d, size_t len) {
+  uint8_t data[2048];
+  ssize_t n;
+
+  emitted = 0;
+  if (send(tx, d, len, 0) != (ssize_t)len) {
+    perror("send");
+    exit(1);
+  }
+  n = recv(rx, data, sizeof(data), 0);
+  if (n < 0) {
+    perror("recv");
+    exit(1);
+  }
+  CHECK((size_t)n == len);
+  return decode_datagram(state, data, (size_t)n, collect, NULL);
+}
+
+static size_t fill(datagram_t *d, uint32_t seq, uint32_t time,
+                   const uint16_t *offsets, unsigned count) {
+  memset(d, 0, sizeof(*d));
+  d->header.magic = TELEMETRY_MAGIC;
+  d->header.seq = seq;
+  d->header.time = time;
+  d->header.frequency = 10000;
+  d->header.channels = TELEMETRY_CHANNELS;
+  d->header.count = count;
+  for (unsigned i = 0; i < count; i++) {
+    d->records[i].offset = offsets[i];
+    for (unsigned c = 0; c < TELEMETRY_CHANNELS; c++) {
+      d->records[i].values[c] = seq * 1000 + i * 10 + c;
+    }
+  }
+  return sizeof(d->header) + count * sizeof(d->records[0]);
+}
+
+static void sockets(void) {
+  struct sockaddr_in addr;
+  socklen_t addrlen = sizeof(addr);
+  struct timeval timeout = {1, 0};
+
+  rx = socket(AF_INET, SOCK_DGRAM, 0);
+  tx = socket(AF_INET, SOCK_DGRAM, 0);
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (rx < 0 || tx < 0 ||
+      bind(rx, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+      getsockname(rx, (struct sockaddr *)&addr, &addrlen) != 0 ||
+      connect(tx, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+      setsockopt(rx, SOL_SOCKET, SO_RCVTIMEO, &timeout,
+                 sizeof(timeout)) != 0) {
+    perror("socket");
+    exit(1);
+  }
+}
+
+int main(void) {
+  static const uint16_t wrap[] = {0, 0x00ff, 0x0100, 0x8000, 0xffff};
+  uint16_t full[BATCH];
+  decode_state_t state = {0};
+  datagram_t d;
+  size_t len;
+
+  /* The header is 18 bytes and a record 2 + 4 * 4, as documented.*/
+  CHECK(sizeof(telemetry_header_t) == DECODE_HEADER_SIZE);
+  CHECK(sizeof(telemetry_record_t) == 2 + 4 * TELEMETRY_CHANNELS);
+
+  sockets();
+
+  /* Offsets across the wrap of the 32 bit tick counter.*/
+  len = fill(&d, 7, 0xffffff00u, wrap, 5);
+  CHECK(roundtrip(&state, &d, len) == 5);
+  CHECK(emitted == 5);
+  CHECK(samples[0].seq == 7 && samples[0].frequency == 10000);
+  CHECK(samples[0].channels == TELEMETRY_CHANNELS);
+  CHECK(samples[0].time == 0xffffff00u);
+  CHECK(samples[1].time == 0xffffffffu);
+  CHECK(samples[2].time == 0);
+  CHECK(samples[3].time == 0x7f00);
+  CHECK(samples[4].time == 0xfeff);
+  CHECK(samples[4].values[0] == 7040 && samples[4].values[3] == 7043);
+  CHECK(state.lost == 0);
+
+  /* A full batch, the size the target sends.*/
+  for (unsigned i = 0; i < BATCH; i++) {
+    full[i] = i * 10;
+  }
+  len = fill(&d, 8, 1000, full, BATCH);
+  CHECK(len == DECODE_HEADER_SIZE + BATCH * (2 + 4 * TELEMETRY_CHANNELS));
+  CHECK(roundtrip(&state, &d, len) == BATCH);
+  CHECK(samples[BATCH - 1].time == 1000 + (BATCH - 1) * 10);
+  CHECK(state.lost == 0);
+
+  /* Seq 9 and 10 lost.*/
+  len = fill(&d, 11, 2000, wrap, 1);
+  CHECK(roundtrip(&state, &d, len) == 1);
+  CHECK(state.lost == 2);
+
+  /* Bad magic.*/
+  len = fill(&d, 12, 3000, wrap, 1);
+  d.header.magic ^= 1;
+  CHECK(roundtrip(&state, &d, len) == -1);
+  CHECK(emitted == 0);
+
+  /* Truncated, the header claims two records.*/
+  len = fill(&d, 12, 3000, wrap, 2);
+  CHECK(roundtrip(&state, &d, len - 1) == -1);
+  CHECK(roundtrip(&state, &d, DECODE_HEADER_SIZE - 1) == -1);
+  CHECK(state.rejected == 3);
+
+  /* Rejected datagrams do not advance the sequence.*/
+  CHECK(roundtrip(&state, &d, len) == 2);
+  CHECK(state.lost == 2);
+
+  /* An empty datagram is valid.*/
+  len = fill(&d, 13, 4000, wrap, 0);
+  CHECK(roundtrip(&state, &d, len) == 0);
+
+  /* A reboot restarts the sequence without counting a loss.*/
+  len = fill(&d, 0, 0, wrap, 1);
+  CHECK(roundtrip(&state, &d, len) == 1);
+  CHECK(state.lost == 2);
+  CHECK(state.datagrams == 6 && state.samples == 5 + BATCH + 1 + 2 + 1);
+
+  close(tx);
+  close(rx);
+  if (failures != 0) {
+    fprintf(stderr, "telemetry_test: %d failures\n", failures);
+    return 1;
+  }
+  printf("telemetry_test: ok\n");
+  return 0;
+}
@@ -0,0 +1,145 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file events.c
+ * @brief Server-Sent Events telemetry stream code.
+ * @details The events thread formats one frame per status sample and
+ *          publishes it in a latch, subscribers are woken by a broadcast
+ *          and always send the latest frame. A subscriber stalled in
+ *          netconn_write() simply misses the frames published meanwhile,
+ *          it never holds back the producer or the other subscribers.
+ * @addtogroup WEB_EVENTS
+ * @{
+ */
+
+#include <string.h>
+
+#include "ch.h"
+
+#include "hal.h" /* chprintf */
+#include "chprintf.h" /* chprintf */
+
+#include "lwip/opt.h"
+#include "lwip/arch.h"
+#include "lwip/api.h"
+
+#include "events.h"
+#include "json.h"
+#include "latch.h"
+#include "status.h"
+
+#if LWIP_NETCONN
+
+typedef struct frame {
+  uint32_t seq;
+  size_t len;
+  char data[EVENTS_FRAME_SIZE];
+} frame_t;
+
+static frame_t frame_buf[2];
+
+static latch_t frame_latch = LATCH_DATA(frame_buf);
+
+static EVENTSOURCE_DECL(frame_event);
+
+static const char events_head[] =
+  "HTTP/1.1 200\r\n"
+  "Content-Type: text/event-stream\r\n"
+  "Cache-Control: no-cache\r\n"
+  "Connection: keep-alive\r\n"
+  "\r\n"
+  "retry: 1000\n\n";
+
+static void frame_format(frame_t *frame, const status_t *status) {
+  json_t *json = &(json_t) {0};
+  size_t len;
+
+  len = chsnprintf(frame->data, EVENTS_FRAME_SIZE,
+                   "id: %u\ndata: ", (unsigned int)frame->seq);
+
+  json_begin(json, frame->data + len, EVENTS_FRAME_SIZE - len - 2, NULL);
+  json_uint(json, "time", TIME_I2MS(status->system.time));
+  json_uint(json, "heap", status->system.heap_free);
+  json_uint(json, "fragments", status->system.heap_fragments);
+  json_uint(json, "core", status->system.core_free);
+  json_uint(json, "requests", status->app.requests);
+  json_bool(json, "link", status->net.link);
+  len += json_end(json);
+
+  memcpy(frame->data + len, "\n\n", 2);
+  frame->len = len + 2;
+}
+
+/**
+ * @brief Streams telemetry frames on @p conn until the client goes away.
+ * @details Called by a helper thread owning @p conn, at most one frame is
+ *          sent every @p interval.
+ */
+void events_serve(struct netconn *conn, sysinterval_t interval) {
+  frame_t frame;
+  event_listener_t el;
+
+  if (netconn_write(conn, events_head, strlen(events_head),
+                    NETCONN_NOCOPY) != ERR_OK) {
+    return;
+  }
+
+  chEvtRegisterMask(&frame_event, &el, EVENT_MASK(0));
+
+  while (true) {
+    /* Pending since the last write if a newer frame was published while
+       sleeping or blocked in netconn_write().*/
+    chEvtWaitAny(EVENT_MASK(0));
+
+    latch_read(&frame_latch, &frame);
+    if (netconn_write(conn, frame.data, frame.len, NETCONN_COPY) != ERR_OK) {
+      break;
+    }
+
+    chThdSleep(interval);
+  }
+
+  chEvtUnregister(&frame_event, &el);
+}
+
+THD_WORKING_AREA(wa_events, EVENTS_THREAD_STACK_SIZE);
+
+THD_FUNCTION(events_thread, p) {
+  static status_t status;
+  static frame_t frame;
+  event_listener_t el;
+
+  (void)p;
+  chRegSetThreadName("events");
+
+  chEvtRegisterMask(&status_event, &el, EVENT_MASK(0));
+
+  while (true) {
+    chEvtWaitAny(EVENT_MASK(0));
+
+    status_read(&status);
+    frame.seq++;
+    frame_format(&frame, &status);
+    latch_write(&frame_latch, &frame);
+
+    chEvtBroadcast(&frame_event);
+  }
+}
+
+#endif
+
+/** @} */
@@ -0,0 +1,58 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file events.h
+ * @brief Server-Sent Events telemetry stream macros and structures.
+ * @addtogroup WEB_EVENTS
+ * @{
+ */
+
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#ifndef EVENTS_THREAD_STACK_SIZE
+#define EVENTS_THREAD_STACK_SIZE    512
+#endif
+
+#ifndef EVENTS_THREAD_PRIORITY
+#define EVENTS_THREAD_PRIORITY      (LOWPRIO + 2)
+#endif
+
+#ifndef EVENTS_FRAME_SIZE
+#define EVENTS_FRAME_SIZE           256
+#endif
+
+#ifndef EVENTS_INTERVAL_MS
+#define EVENTS_INTERVAL_MS          1000
+#endif
+
+struct netconn;
+
+extern THD_WORKING_AREA(wa_events, EVENTS_THREAD_STACK_SIZE);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  THD_FUNCTION(events_thread, p);
+  void events_serve(struct netconn *conn, sysinterval_t interval);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EVENTS_H */
+
+/** @} */
@@ -0,0 +1,407 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file json.c
+ * @brief JSON writer with field selection code.
+ * @details The selector is a comma separated list of dotted paths, e.g.
+ *          "uptime,heap.free,threads.name". A key is written when its path
+ *          equals a selector or lies below one, containers are also opened
+ *          when a selector lies below them. Array elements share the path
+ *          of their array.
+ * @addtogroup WEB_JSON
+ * @{
+ */
+
+#include <stdarg.h>
+#include <string.h>
+
+#include "ch.h"
+
+#include "hal.h" /* chprintf */
+#include "chprintf.h" /* chprintf */
+
+#include "json.h"
+
+typedef enum {
+  MATCH_NONE,
+  MATCH_PARTIAL,
+  MATCH_FULL,
+} match_t;
+
+static int hex_value(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+static void json_putc(json_t *js, char c) {
+  if (js->len + 1 >= js->size && js->flush) {
+    json_flush(js);
+  }
+  if (js->len + 1 < js->size) {
+    js->data[js->len++] = c;
+    js->data[js->len] = '\0';
+  } else {
+    js->overflow = true;
+  }
+}
+
+static void json_printf(json_t *js, const char *fmt, ...) {
+  va_list ap;
+  int n;
+
+  if (js->len + 1 >= js->size && js->flush) {
+    json_flush(js);
+  }
+  if (js->len + 1 >= js->size) {
+    js->overflow = true;
+    return;
+  }
+
+  va_start(ap, fmt);
+  n = chvsnprintf(js->data + js->len, js->size - js->len, fmt, ap);
+  va_end(ap);
+
+  /* A streaming writer retries in an empty buffer once.*/
+  if (js->len + n >= js->size && js->flush && js->len > 0) {
+    js->data[js->len] = '\0';
+    json_flush(js);
+    va_start(ap, fmt);
+    n = chvsnprintf(js->data, js->size, fmt, ap);
+    va_end(ap);
+  }
+
+  if (js->len + n >= js->size) {
+    js->len = js->size - 1;
+    js->overflow = true;
+  } else {
+    js->len += n;
+  }
+}
+
+static void json_quote(json_t *js, const char *s) {
+  json_putc(js, '"');
+  while (*s != '\0') {
+    char c = *s++;
+    if (c == '"' || c == '\\') {
+      json_putc(js, '\\');
+      json_putc(js, c);
+    } else if ((unsigned char)c < 0x20) {
+      json_printf(js, "\\u%04x", (unsigned int)c);
+    } else {
+      json_putc(js, c);
+    }
+  }
+  json_putc(js, '"');
+}
+
+static size_t json_path_push(json_t *js, const char *key) {
+  size_t len = js->path_len[js->depth];
+  size_t key_len;
+
+  if (key == NULL) {
+    return len;
+  }
+
+  if (len > 0 && len + 1 < sizeof(js->path)) {
+    js->path[len++] = '.';
+  }
+  key_len = strlen(key);
+  if (len + key_len >= sizeof(js->path)) {
+    key_len = sizeof(js->path) - 1 - len;
+  }
+  memcpy(js->path + len, key, key_len);
+  len += key_len;
+  js->path[len] = '\0';
+  return len;
+}
+
+static match_t json_match(const json_t *js, size_t len) {
+  match_t match = MATCH_NONE;
+
+  if (js->selected[js->depth]) {
+    return MATCH_FULL;
+  }
+
+  for (int i = 0; i < js->fields->count; i++) {
+    const char *s = js->fields->path[i];
+    size_t s_len = strlen(s);
+    if (s_len < len || memcmp(s, js->path, len) != 0) {
+      continue;
+    }
+    if (s_len == len) {
+      return MATCH_FULL;
+    }
+    if (s[len] == '.') {
+      match = MATCH_PARTIAL;
+    }
+  }
+  return match;
+}
+
+static void json_key(json_t *js, const char *key) {
+  if (!js->first[js->depth]) {
+    json_putc(js, ',');
+  }
+  js->first[js->depth] = false;
+
+  if (key) {
+    json_quote(js, key);
+    json_putc(js, ':');
+  }
+}
+
+static bool json_scalar(json_t *js, const char *key) {
+  if (json_match(js, json_path_push(js, key)) != MATCH_FULL) {
+    return false;
+  }
+  json_key(js, key);
+  return true;
+}
+
+static bool json_open(json_t *js, const char *key, char c) {
+  size_t len = json_path_push(js, key);
+  match_t match = json_match(js, len);
+
+  if (match == MATCH_NONE || js->depth + 1 >= JSON_DEPTH) {
+    return false;
+  }
+
+  json_key(js, key);
+  json_putc(js, c);
+
+  js->depth++;
+  js->path_len[js->depth] = len;
+  js->first[js->depth] = true;
+  js->selected[js->depth] = (match == MATCH_FULL);
+  return true;
+}
+
+static void json_close(json_t *js, char c) {
+  json_putc(js, c);
+  js->depth--;
+}
+
+/**
+ * @brief Copies the URL decoded value of query parameter @p name.
+ * @note  @p value is set to an empty string if the parameter is missing.
+ */
+void query_get(const char *query, const char *name, char *value, size_t size) {
+  size_t name_len = strlen(name);
+  size_t len = 0;
+
+  value[0] = '\0';
+  while (query && *query != '\0') {
+    size_t pair_len = strcspn(query, "&");
+    if (pair_len > name_len && query[name_len] == '=' &&
+        memcmp(query, name, name_len) == 0) {
+      const char *s = query + name_len + 1;
+      const char *end = query + pair_len;
+      while (s < end && len + 1 < size) {
+        if (*s == '%' && end - s > 2 &&
+            hex_value(s[1]) >= 0 && hex_value(s[2]) >= 0) {
+          value[len++] = (char)(hex_value(s[1]) << 4 | hex_value(s[2]));
+          s += 3;
+        } else if (*s == '+') {
+          value[len++] = ' ';
+          s++;
+        } else {
+          value[len++] = *s++;
+        }
+      }
+      value[len] = '\0';
+      return;
+    }
+    query += pair_len;
+    if (*query == '&') {
+      query++;
+    }
+  }
+}
+
+/**
+ * @brief Parses the "fields" parameter of @p query into @p fields.
+ */
+void fields_parse(fields_t *fields, const char *query) {
+  char value[JSON_FIELDS_COUNT * JSON_FIELD_SIZE];
+  const char *s = value;
+
+  fields->count = 0;
+  query_get(query, "fields", value, sizeof(value));
+
+  while (*s != '\0' && fields->count < JSON_FIELDS_COUNT) {
+    size_t len;
+
+    while (*s == ',' || *s == ' ') {
+      s++;
+    }
+    len = strcspn(s, ", ");
+    if (len > 0 && len < JSON_FIELD_SIZE) {
+      memcpy(fields->path[fields->count], s, len);
+      fields->path[fields->count][len] = '\0';
+      fields->count++;
+    }
+    s += len;
+  }
+}
+
+/**
+ * @brief Starts a JSON document in @p data, opening the root object.
+ * @param fields selector, @p NULL selects everything.
+ */
+void json_begin(json_t *js, char *data, size_t size, const fields_t *fields) {
+  js->data = data;
+  js->size = size;
+  js->len = 0;
+  js->overflow = false;
+  js->flush = NULL;
+  js->arg = NULL;
+  js->fields = fields;
+  js->path[0] = '\0';
+  js->depth = 0;
+  js->path_len[0] = 0;
+  js->first[0] = true;
+  js->selected[0] = (fields == NULL) || (fields->count == 0);
+
+  if (size > 0) {
+    data[0] = '\0';
+  }
+  json_putc(js, '{');
+}
+
+/**
+ * @brief Closes the root object.
+ * @return The document length.
+ */
+size_t json_end(json_t *js) {
+  json_putc(js, '}');
+  return js->len;
+}
+
+/**
+ * @brief Makes @p js a streaming writer flushing to @p flush.
+ * @note  Must be called right after json_begin(), the opening brace is
+ *        still in the buffer.
+ */
+void json_sink(json_t *js, json_flush_t flush, void *arg) {
+  js->flush = flush;
+  js->arg = arg;
+}
+
+/**
+ * @brief Hands the buffered output to the sink and empties the buffer.
+ */
+void json_flush(json_t *js) {
+  if (js->flush && js->len > 0) {
+    js->flush(js->arg, js->data, js->len);
+    js->len = 0;
+    js->data[0] = '\0';
+  }
+}
+
+/**
+ * @brief Opens an object, @p key is @p NULL inside arrays.
+ * @return false if the object is not selected, its content must then be
+ *         skipped and json_object_close() must not be called.
+ */
+bool json_object_open(json_t *js, const char *key) {
+  return json_open(js, key, '{');
+}
+
+void json_object_close(json_t *js) {
+  json_close(js, '}');
+}
+
+/**
+ * @brief Opens an array, see json_object_open().
+ */
+bool json_array_open(json_t *js, const char *key) {
+  return json_open(js, key, '[');
+}
+
+void json_array_close(json_t *js) {
+  json_close(js, ']');
+}
+
+void json_int(json_t *js, const char *key, long value) {
+  if (json_scalar(js, key)) {
+    json_printf(js, "%ld", value);
+  }
+}
+
+void json_uint(json_t *js, const char *key, unsigned long value) {
+  if (json_scalar(js, key)) {
+    json_printf(js, "%lu", value);
+  }
+}
+
+/**
+ * @brief Writes @p value with three decimals, out of range values as null.
+ */
+void json_float(json_t *js, const char *key, float value) {
+  float magnitude = value < 0.0f ? -value : value;
+  unsigned long whole, frac;
+
+  if (!json_scalar(js, key)) {
+    return;
+  }
+
+  /* Also catches NaN, the comparison is false.*/
+  if (!(magnitude < 4.0e9f)) {
+    json_printf(js, "null");
+    return;
+  }
+
+  whole = (unsigned long)magnitude;
+  frac = (unsigned long)((magnitude - (float)whole) * 1000.0f + 0.5f);
+  if (frac >= 1000) {
+    whole++;
+    frac -= 1000;
+  }
+  json_printf(js, "%s%lu.%03lu", value < 0.0f ? "-" : "", whole, frac);
+}
+
+/**
+ * @brief Writes @p whole with @p thousandths as three exact decimals.
+ */
+void json_fixed(json_t *js, const char *key, unsigned long whole,
+                unsigned long thousandths) {
+  if (json_scalar(js, key)) {
+    json_printf(js, "%lu.%03lu", whole, thousandths % 1000);
+  }
+}
+
+void json_bool(json_t *js, const char *key, bool value) {
+  if (json_scalar(js, key)) {
+    json_printf(js, "%s", value ? "true" : "false");
+  }
+}
+
+void json_string(json_t *js, const char *key, const char *value) {
+  if (json_scalar(js, key)) {
+    json_quote(js, value);
+  }
+}
+
+/** @} */
@@ -0,0 +1,108 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file json.h
+ * @brief JSON writer with field selection macros and structures.
+ * @addtogroup WEB_JSON
+ * @{
+ */
+
+#ifndef JSON_H
+#define JSON_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifndef JSON_FIELDS_COUNT
+#define JSON_FIELDS_COUNT       8
+#endif
+
+#ifndef JSON_FIELD_SIZE
+#define JSON_FIELD_SIZE         32
+#endif
+
+#ifndef JSON_PATH_SIZE
+#define JSON_PATH_SIZE          64
+#endif
+
+#ifndef JSON_DEPTH
+#define JSON_DEPTH              8
+#endif
+
+/**
+ * @brief Field selector parsed from a "fields=a,b.c" query parameter.
+ * @note  An empty selector (count == 0) selects the whole document.
+ */
+typedef struct fields {
+  char path[JSON_FIELDS_COUNT][JSON_FIELD_SIZE];
+  int count;
+} fields_t;
+
+/**
+ * @brief Receives the buffered output of a streaming writer.
+ */
+typedef void (*json_flush_t)(void *arg, const char *data, size_t len);
+
+/**
+ * @brief JSON writer state.
+ * @details Keys are matched against the selector while writing, callers
+ *          skip rendering of sections for which an open call returns false.
+ *          With a sink set the buffer is flushed whenever it fills up, the
+ *          document size is then unbounded.
+ */
+typedef struct json {
+  char *data;
+  size_t size;
+  size_t len;
+  bool overflow;
+  json_flush_t flush;
+  void *arg;
+  const fields_t *fields;
+  char path[JSON_PATH_SIZE];
+  size_t path_len[JSON_DEPTH];
+  bool first[JSON_DEPTH];
+  bool selected[JSON_DEPTH];
+  int depth;
+} json_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void query_get(const char *query, const char *name, char *value, size_t size);
+  void fields_parse(fields_t *fields, const char *query);
+  void json_begin(json_t *js, char *data, size_t size, const fields_t *fields);
+  size_t json_end(json_t *js);
+  void json_sink(json_t *js, json_flush_t flush, void *arg);
+  void json_flush(json_t *js);
+  bool json_object_open(json_t *js, const char *key);
+  void json_object_close(json_t *js);
+  bool json_array_open(json_t *js, const char *key);
+  void json_array_close(json_t *js);
+  void json_int(json_t *js, const char *key, long value);
+  void json_uint(json_t *js, const char *key, unsigned long value);
+  void json_float(json_t *js, const char *key, float value);
+  void json_fixed(json_t *js, const char *key, unsigned long whole,
+                  unsigned long thousandths);
+  void json_bool(json_t *js, const char *key, bool value);
+  void json_string(json_t *js, const char *key, const char *value);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* JSON_H */
+
+/** @} */
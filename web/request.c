@@ -0,0 +1,227 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file request.c
+ * @brief HTTP request parser code.
+ * @addtogroup WEB_REQUEST
+ * @{
+ */
+
+#include <string.h>
+
+#include "request.h"
+
+/* Copies a request token, tokens that do not fit are rejected.*/
+bool token_copy(char *dst, size_t size, const char *src, size_t len) {
+  if (len == 0 || len >= size) {
+    return false;
+  }
+  memcpy(dst, src, len);
+  dst[len] = '\0';
+  return true;
+}
+
+/* Copies a header field, fields that do not fit are truncated.*/
+void field_copy(char *dst, size_t size, const char *src, size_t len) {
+  if (len >= size) {
+    len = size - 1;
+  }
+  memcpy(dst, src, len);
+  dst[len] = '\0';
+}
+
+void request_query_split(request_t *request) {
+  request->query = strchr(request->url, '?');
+  if (request->query) {
+    *request->query++ = '\0';
+  }
+}
+
+/**
+ * @brief Parses the NUL terminated request in @p raw into @p request.
+ * @details The header lines are copied into the HEADER_COUNT entries of
+ *          @p headers.
+ * @return false if the request line or a header line is malformed.
+ */
+bool request_parse(request_t *request, header_t *headers, const char *raw) {
+  size_t method_len = strcspn(raw, " ");
+  if (raw[method_len] != ' ' ||
+      !token_copy(request->method, REQUEST_METHOD_SIZE, raw, method_len)) {
+    return false;
+  }
+  raw += method_len + 1;
+
+  size_t url_len = strcspn(raw, " \r\n");
+  if (raw[url_len] != ' ' ||
+      !token_copy(request->url, REQUEST_URL_SIZE, raw, url_len)) {
+    return false;
+  }
+  raw += url_len + 1;
+
+  request_query_split(request);
+
+  size_t protocol_len = strcspn(raw, "\r\n");
+  if (raw[protocol_len] != '\r' || raw[protocol_len + 1] != '\n' ||
+      !token_copy(request->protocol, REQUEST_PROTOCOL_SIZE, raw, protocol_len)) {
+    return false;
+  }
+  raw += protocol_len + 2;
+
+  int i = 0;
+  request->headers = NULL;
+  while (raw[0]!='\r' || raw[1]!='\n') {
+    if (i >= HEADER_COUNT) {
+      return false;
+    }
+
+    size_t name_len = strcspn(raw, ":\r\n");
+    if (raw[name_len] != ':') {
+      return false;
+    }
+    field_copy(headers[i].name, HEADER_NAME_SIZE, raw, name_len);
+    raw += name_len + 1;
+
+    while (*raw == ' ') {
+      raw++;
+    }
+
+    size_t value_len = strcspn(raw, "\r\n");
+    if (raw[value_len] != '\r' || raw[value_len + 1] != '\n') {
+      return false;
+    }
+    field_copy(headers[i].value, HEADER_VALUE_SIZE, raw, value_len);
+    raw += value_len + 2;
+
+    headers[i].next = NULL;
+    if (i > 0) {
+      headers[i-1].next = &headers[i];
+    }
+
+    i++;
+  }
+  raw += 2;
+
+  if (i > 0) {
+    request->headers = headers;
+  }
+
+  field_copy(request->body, REQUEST_BODY_SIZE, raw, strlen(raw));
+  return true;
+}
+
+/**
+ * @brief Copies the first JSON object of @p raw into @p js.
+ * @details Nested objects are cut at the first closing brace, jsmn then
+ *          rejects them. @p js is empty if @p raw has no object.
+ */
+void json_get(char *js, size_t size, const char *raw) {
+  raw = strchr(raw, '{');
+  if (raw == NULL) {
+    js[0] = '\0';
+    return;
+  }
+
+  size_t json_len = strcspn(raw, "}");
+  if (raw[json_len] == '}') {
+    json_len++;
+  }
+  if (json_len >= size) {
+    json_len = size - 1;
+  }
+  memcpy(js, raw, json_len);
+  js[json_len] = '\0';
+}
+
+/* Value of a hex digit, -1 if @p c is not one.*/
+static int hex_value(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+/**
+ * @brief Decodes the @p len bytes of a JSON string token into @p dst.
+ * @details Escapes of characters outside ASCII become '?', malformed
+ *          escapes end the string. A value that does not fit is cut
+ *          before the last incomplete UTF-8 sequence.
+ */
+void json_unescape(char *dst, size_t size, const char *src, size_t len) {
+  static const char escapes[] = "\"\"\\\\//b\bf\fn\nr\rt\t";
+  const char *end = src + len;
+  size_t n = 0;
+
+  while (src < end && n < size - 1) {
+    char c = *src++;
+
+    if (c == '\\') {
+      const char *e;
+
+      if (src == end) {
+        break;
+      }
+      c = *src++;
+      if (c == 'u') {
+        int code = 0;
+
+        for (int i = 0; i < 4; i++) {
+          int v = src < end ? hex_value(*src++) : -1;
+          if (v < 0) {
+            dst[n] = '\0';
+            return;
+          }
+          code = code << 4 | v;
+        }
+        if (code == 0) {
+          break;
+        }
+        c = code < 0x80 ? (char)code : '?';
+      } else if (c != '\0' && (e = strchr(escapes, c)) != NULL &&
+                 ((e - escapes) & 1) == 0) {
+        c = e[1];
+      } else {
+        break;
+      }
+    }
+    dst[n++] = c;
+  }
+
+  if (src < end && n == size - 1) {
+    size_t i = n;
+
+    while (i > 0 && ((unsigned char)dst[i - 1] & 0xC0) == 0x80) {
+      i--;
+    }
+    if (i > 0 && ((unsigned char)dst[i - 1] & 0xC0) == 0xC0) {
+      unsigned char lead = (unsigned char)dst[i - 1];
+      size_t need = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : 2;
+
+      if (n - (i - 1) < need) {
+        n = i - 1;
+      }
+    }
+  }
+  dst[n] = '\0';
+}
+
+/** @} */
@@ -0,0 +1,89 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file request.h
+ * @brief HTTP request parser macros and structures.
+ * @details The parser only depends on the C library, it is also built on
+ *          the host for fuzzing and benchmarking, see tools/host.
+ * @addtogroup WEB_REQUEST
+ * @{
+ */
+
+#ifndef REQUEST_H
+#define REQUEST_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define REQUEST_SIZE 1536
+#define HEADER_COUNT 16
+#define HEADER_NAME_SIZE 32
+#define HEADER_VALUE_SIZE 128
+#define REQUEST_BODY_SIZE 1024
+#define REQUEST_URL_SIZE 128
+#define REQUEST_METHOD_SIZE 8
+#define REQUEST_PROTOCOL_SIZE 16
+
+typedef struct header {
+  char *name;
+  char *value;
+  struct header *next;
+} header_t;
+
+/* Points in the life of a request, the phases are the times between them.*/
+typedef enum {
+  HTTP_MARK_ACCEPTED,
+  HTTP_MARK_RECEIVED,
+  HTTP_MARK_PARSED,
+  HTTP_MARK_HANDLED,
+  HTTP_MARK_WRITTEN,
+  HTTP_MARK_CLOSED,
+  HTTP_MARKS
+} http_mark_t;
+
+struct netconn;
+
+typedef struct request {
+  struct netconn *conn;
+  bool detached;
+  int route;
+  uint32_t marks[HTTP_MARKS];
+  char *method;
+  char *url;
+  char *query;
+  char *protocol;
+  header_t *headers;
+  char *body;
+} request_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  bool token_copy(char *dst, size_t size, const char *src, size_t len);
+  void field_copy(char *dst, size_t size, const char *src, size_t len);
+  void request_query_split(request_t *request);
+  bool request_parse(request_t *request, header_t *headers, const char *raw);
+  void json_get(char *js, size_t size, const char *raw);
+  void json_unescape(char *dst, size_t size, const char *src, size_t len);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* REQUEST_H */
+
+/** @} */
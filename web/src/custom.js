@@ -3,3 +3,44 @@
 //       console.log(data.user);
 //   }, "json");
 // })
+
+var points = 120;
+
+var chart = new Chart($("#telemetry"), {
+  type: "line",
+  data: {
+    labels: [],
+    datasets: [
+      {label: "heap", data: [], fill: false, borderColor: "#007bff"},
+      {label: "core", data: [], fill: false, borderColor: "#28a745"}
+    ]
+  },
+  options: {animation: false}
+});
+
+var events = new EventSource("/events?interval=1000");
+events.onmessage = function(e) {
+  var sample = JSON.parse(e.data);
+  chart.data.labels.push(sample.time / 1000);
+  chart.data.datasets[0].data.push(sample.heap);
+  chart.data.datasets[1].data.push(sample.core);
+  if (chart.data.labels.length > points) {
+    chart.data.labels.shift();
+    chart.data.datasets.forEach(function(d) { d.data.shift(); });
+  }
+  chart.update();
+};
+
+var socket = new WebSocket("ws://" + location.host + "/ws");
+socket.onmessage = function(e) {
+  var message = JSON.parse(e.data);
+  if (message.t !== undefined) {
+    $("#rtt").text((performance.now() - message.t).toFixed(1) + " ms");
+  }
+};
+
+$("button").click(function() {
+  if (socket.readyState === WebSocket.OPEN) {
+    socket.send(JSON.stringify({"t": performance.now()}));
+  }
+});
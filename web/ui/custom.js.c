@@ -13,8 +13,110 @@ const unsigned char custom_js[] = {
   0x2f, 0x2f, 0x20, 0x24, 0x28, 0x22, 0x62, 0x75, 0x74, 0x74, 0x6f, 0x6e,
   0x22, 0x29, 0x2e, 0x63, 0x6c, 0x69, 0x63, 0x6b, 0x28, 0x66, 0x75, 0x6e,
   0x63, 0x74, 0x69, 0x6f, 0x6e, 0x28, 0x29, 0x20, 0x7b, 0x0a, 0x2f, 0x2f,
-  0x20, 0x20, 0x20, 0x24, 0x2e, 0x67, 0x65, 0x74, 0x4a, 0x53, 0x4f, 0x4e,
-  0x28, 0x22, 0x2f, 0x73, 0x74, 0x61, 0x74, 0x75, 0x73, 0x22, 0x29, 0x0a,
-  0x2f, 0x2f, 0x20, 0x7d, 0x29, 0x0a
+  0x20, 0x09, 0x24, 0x2e, 0x70, 0x6f, 0x73, 0x74, 0x28, 0x20, 0x22, 0x2f,
+  0x70, 0x72, 0x6f, 0x66, 0x69, 0x6c, 0x65, 0x22, 0x2c, 0x20, 0x4a, 0x53,
+  0x4f, 0x4e, 0x2e, 0x73, 0x74, 0x72, 0x69, 0x6e, 0x67, 0x69, 0x66, 0x79,
+  0x28, 0x7b, 0x22, 0x75, 0x73, 0x65, 0x72, 0x22, 0x3a, 0x20, 0x22, 0x61,
+  0x74, 0x69, 0x6c, 0x61, 0x22, 0x7d, 0x29, 0x2c, 0x20, 0x66, 0x75, 0x6e,
+  0x63, 0x74, 0x69, 0x6f, 0x6e, 0x28, 0x20, 0x64, 0x61, 0x74, 0x61, 0x20,
+  0x29, 0x20, 0x7b, 0x0a, 0x2f, 0x2f, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x63, 0x6f, 0x6e, 0x73, 0x6f, 0x6c, 0x65, 0x2e, 0x6c, 0x6f, 0x67,
+  0x28, 0x64, 0x61, 0x74, 0x61, 0x2e, 0x75, 0x73, 0x65, 0x72, 0x29, 0x3b,
+  0x0a, 0x2f, 0x2f, 0x20, 0x20, 0x20, 0x7d, 0x2c, 0x20, 0x22, 0x6a, 0x73,
+  0x6f, 0x6e, 0x22, 0x29, 0x3b, 0x0a, 0x2f, 0x2f, 0x20, 0x7d, 0x29, 0x0a,
+  0x0a, 0x76, 0x61, 0x72, 0x20, 0x70, 0x6f, 0x69, 0x6e, 0x74, 0x73, 0x20,
+  0x3d, 0x20, 0x31, 0x32, 0x30, 0x3b, 0x0a, 0x0a, 0x76, 0x61, 0x72, 0x20,
+  0x63, 0x68, 0x61, 0x72, 0x74, 0x20, 0x3d, 0x20, 0x6e, 0x65, 0x77, 0x20,
+  0x43, 0x68, 0x61, 0x72, 0x74, 0x28, 0x24, 0x28, 0x22, 0x23, 0x74, 0x65,
+  0x6c, 0x65, 0x6d, 0x65, 0x74, 0x72, 0x79, 0x22, 0x29, 0x2c, 0x20, 0x7b,
+  0x0a, 0x20, 0x20, 0x74, 0x79, 0x70, 0x65, 0x3a, 0x20, 0x22, 0x6c, 0x69,
+  0x6e, 0x65, 0x22, 0x2c, 0x0a, 0x20, 0x20, 0x64, 0x61, 0x74, 0x61, 0x3a,
+  0x20, 0x7b, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x6c, 0x61, 0x62, 0x65, 0x6c,
+  0x73, 0x3a, 0x20, 0x5b, 0x5d, 0x2c, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x64,
+  0x61, 0x74, 0x61, 0x73, 0x65, 0x74, 0x73, 0x3a, 0x20, 0x5b, 0x0a, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x7b, 0x6c, 0x61, 0x62, 0x65, 0x6c, 0x3a,
+  0x20, 0x22, 0x68, 0x65, 0x61, 0x70, 0x22, 0x2c, 0x20, 0x64, 0x61, 0x74,
+  0x61, 0x3a, 0x20, 0x5b, 0x5d, 0x2c, 0x20, 0x66, 0x69, 0x6c, 0x6c, 0x3a,
+  0x20, 0x66, 0x61, 0x6c, 0x73, 0x65, 0x2c, 0x20, 0x62, 0x6f, 0x72, 0x64,
+  0x65, 0x72, 0x43, 0x6f, 0x6c, 0x6f, 0x72, 0x3a, 0x20, 0x22, 0x23, 0x30,
+  0x30, 0x37, 0x62, 0x66, 0x66, 0x22, 0x7d, 0x2c, 0x0a, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x7b, 0x6c, 0x61, 0x62, 0x65, 0x6c, 0x3a, 0x20, 0x22,
+  0x63, 0x6f, 0x72, 0x65, 0x22, 0x2c, 0x20, 0x64, 0x61, 0x74, 0x61, 0x3a,
+  0x20, 0x5b, 0x5d, 0x2c, 0x20, 0x66, 0x69, 0x6c, 0x6c, 0x3a, 0x20, 0x66,
+  0x61, 0x6c, 0x73, 0x65, 0x2c, 0x20, 0x62, 0x6f, 0x72, 0x64, 0x65, 0x72,
+  0x43, 0x6f, 0x6c, 0x6f, 0x72, 0x3a, 0x20, 0x22, 0x23, 0x32, 0x38, 0x61,
+  0x37, 0x34, 0x35, 0x22, 0x7d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x5d, 0x0a,
+  0x20, 0x20, 0x7d, 0x2c, 0x0a, 0x20, 0x20, 0x6f, 0x70, 0x74, 0x69, 0x6f,
+  0x6e, 0x73, 0x3a, 0x20, 0x7b, 0x61, 0x6e, 0x69, 0x6d, 0x61, 0x74, 0x69,
+  0x6f, 0x6e, 0x3a, 0x20, 0x66, 0x61, 0x6c, 0x73, 0x65, 0x7d, 0x0a, 0x7d,
+  0x29, 0x3b, 0x0a, 0x0a, 0x76, 0x61, 0x72, 0x20, 0x65, 0x76, 0x65, 0x6e,
+  0x74, 0x73, 0x20, 0x3d, 0x20, 0x6e, 0x65, 0x77, 0x20, 0x45, 0x76, 0x65,
+  0x6e, 0x74, 0x53, 0x6f, 0x75, 0x72, 0x63, 0x65, 0x28, 0x22, 0x2f, 0x65,
+  0x76, 0x65, 0x6e, 0x74, 0x73, 0x3f, 0x69, 0x6e, 0x74, 0x65, 0x72, 0x76,
+  0x61, 0x6c, 0x3d, 0x31, 0x30, 0x30, 0x30, 0x22, 0x29, 0x3b, 0x0a, 0x65,
+  0x76, 0x65, 0x6e, 0x74, 0x73, 0x2e, 0x6f, 0x6e, 0x6d, 0x65, 0x73, 0x73,
+  0x61, 0x67, 0x65, 0x20, 0x3d, 0x20, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69,
+  0x6f, 0x6e, 0x28, 0x65, 0x29, 0x20, 0x7b, 0x0a, 0x20, 0x20, 0x76, 0x61,
+  0x72, 0x20, 0x73, 0x61, 0x6d, 0x70, 0x6c, 0x65, 0x20, 0x3d, 0x20, 0x4a,
+  0x53, 0x4f, 0x4e, 0x2e, 0x70, 0x61, 0x72, 0x73, 0x65, 0x28, 0x65, 0x2e,
+  0x64, 0x61, 0x74, 0x61, 0x29, 0x3b, 0x0a, 0x20, 0x20, 0x63, 0x68, 0x61,
+  0x72, 0x74, 0x2e, 0x64, 0x61, 0x74, 0x61, 0x2e, 0x6c, 0x61, 0x62, 0x65,
+  0x6c, 0x73, 0x2e, 0x70, 0x75, 0x73, 0x68, 0x28, 0x73, 0x61, 0x6d, 0x70,
+  0x6c, 0x65, 0x2e, 0x74, 0x69, 0x6d, 0x65, 0x20, 0x2f, 0x20, 0x31, 0x30,
+  0x30, 0x30, 0x29, 0x3b, 0x0a, 0x20, 0x20, 0x63, 0x68, 0x61, 0x72, 0x74,
+  0x2e, 0x64, 0x61, 0x74, 0x61, 0x2e, 0x64, 0x61, 0x74, 0x61, 0x73, 0x65,
+  0x74, 0x73, 0x5b, 0x30, 0x5d, 0x2e, 0x64, 0x61, 0x74, 0x61, 0x2e, 0x70,
+  0x75, 0x73, 0x68, 0x28, 0x73, 0x61, 0x6d, 0x70, 0x6c, 0x65, 0x2e, 0x68,
+  0x65, 0x61, 0x70, 0x29, 0x3b, 0x0a, 0x20, 0x20, 0x63, 0x68, 0x61, 0x72,
+  0x74, 0x2e, 0x64, 0x61, 0x74, 0x61, 0x2e, 0x64, 0x61, 0x74, 0x61, 0x73,
+  0x65, 0x74, 0x73, 0x5b, 0x31, 0x5d, 0x2e, 0x64, 0x61, 0x74, 0x61, 0x2e,
+  0x70, 0x75, 0x73, 0x68, 0x28, 0x73, 0x61, 0x6d, 0x70, 0x6c, 0x65, 0x2e,
+  0x63, 0x6f, 0x72, 0x65, 0x29, 0x3b, 0x0a, 0x20, 0x20, 0x69, 0x66, 0x20,
+  0x28, 0x63, 0x68, 0x61, 0x72, 0x74, 0x2e, 0x64, 0x61, 0x74, 0x61, 0x2e,
+  0x6c, 0x61, 0x62, 0x65, 0x6c, 0x73, 0x2e, 0x6c, 0x65, 0x6e, 0x67, 0x74,
+  0x68, 0x20, 0x3e, 0x20, 0x70, 0x6f, 0x69, 0x6e, 0x74, 0x73, 0x29, 0x20,
+  0x7b, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x63, 0x68, 0x61, 0x72, 0x74, 0x2e,
+  0x64, 0x61, 0x74, 0x61, 0x2e, 0x6c, 0x61, 0x62, 0x65, 0x6c, 0x73, 0x2e,
+  0x73, 0x68, 0x69, 0x66, 0x74, 0x28, 0x29, 0x3b, 0x0a, 0x20, 0x20, 0x20,
+  0x20, 0x63, 0x68, 0x61, 0x72, 0x74, 0x2e, 0x64, 0x61, 0x74, 0x61, 0x2e,
+  0x64, 0x61, 0x74, 0x61, 0x73, 0x65, 0x74, 0x73, 0x2e, 0x66, 0x6f, 0x72,
+  0x45, 0x61, 0x63, 0x68, 0x28, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f,
+  0x6e, 0x28, 0x64, 0x29, 0x20, 0x7b, 0x20, 0x64, 0x2e, 0x64, 0x61, 0x74,
+  0x61, 0x2e, 0x73, 0x68, 0x69, 0x66, 0x74, 0x28, 0x29, 0x3b, 0x20, 0x7d,
+  0x29, 0x3b, 0x0a, 0x20, 0x20, 0x7d, 0x0a, 0x20, 0x20, 0x63, 0x68, 0x61,
+  0x72, 0x74, 0x2e, 0x75, 0x70, 0x64, 0x61, 0x74, 0x65, 0x28, 0x29, 0x3b,
+  0x0a, 0x7d, 0x3b, 0x0a, 0x0a, 0x76, 0x61, 0x72, 0x20, 0x73, 0x6f, 0x63,
+  0x6b, 0x65, 0x74, 0x20, 0x3d, 0x20, 0x6e, 0x65, 0x77, 0x20, 0x57, 0x65,
+  0x62, 0x53, 0x6f, 0x63, 0x6b, 0x65, 0x74, 0x28, 0x22, 0x77, 0x73, 0x3a,
+  0x2f, 0x2f, 0x22, 0x20, 0x2b, 0x20, 0x6c, 0x6f, 0x63, 0x61, 0x74, 0x69,
+  0x6f, 0x6e, 0x2e, 0x68, 0x6f, 0x73, 0x74, 0x20, 0x2b, 0x20, 0x22, 0x2f,
+  0x77, 0x73, 0x22, 0x29, 0x3b, 0x0a, 0x73, 0x6f, 0x63, 0x6b, 0x65, 0x74,
+  0x2e, 0x6f, 0x6e, 0x6d, 0x65, 0x73, 0x73, 0x61, 0x67, 0x65, 0x20, 0x3d,
+  0x20, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x28, 0x65, 0x29,
+  0x20, 0x7b, 0x0a, 0x20, 0x20, 0x76, 0x61, 0x72, 0x20, 0x6d, 0x65, 0x73,
+  0x73, 0x61, 0x67, 0x65, 0x20, 0x3d, 0x20, 0x4a, 0x53, 0x4f, 0x4e, 0x2e,
+  0x70, 0x61, 0x72, 0x73, 0x65, 0x28, 0x65, 0x2e, 0x64, 0x61, 0x74, 0x61,
+  0x29, 0x3b, 0x0a, 0x20, 0x20, 0x69, 0x66, 0x20, 0x28, 0x6d, 0x65, 0x73,
+  0x73, 0x61, 0x67, 0x65, 0x2e, 0x74, 0x20, 0x21, 0x3d, 0x3d, 0x20, 0x75,
+  0x6e, 0x64, 0x65, 0x66, 0x69, 0x6e, 0x65, 0x64, 0x29, 0x20, 0x7b, 0x0a,
+  0x20, 0x20, 0x20, 0x20, 0x24, 0x28, 0x22, 0x23, 0x72, 0x74, 0x74, 0x22,
+  0x29, 0x2e, 0x74, 0x65, 0x78, 0x74, 0x28, 0x28, 0x70, 0x65, 0x72, 0x66,
+  0x6f, 0x72, 0x6d, 0x61, 0x6e, 0x63, 0x65, 0x2e, 0x6e, 0x6f, 0x77, 0x28,
+  0x29, 0x20, 0x2d, 0x20, 0x6d, 0x65, 0x73, 0x73, 0x61, 0x67, 0x65, 0x2e,
+  0x74, 0x29, 0x2e, 0x74, 0x6f, 0x46, 0x69, 0x78, 0x65, 0x64, 0x28, 0x31,
+  0x29, 0x20, 0x2b, 0x20, 0x22, 0x20, 0x6d, 0x73, 0x22, 0x29, 0x3b, 0x0a,
+  0x20, 0x20, 0x7d, 0x0a, 0x7d, 0x3b, 0x0a, 0x0a, 0x24, 0x28, 0x22, 0x62,
+  0x75, 0x74, 0x74, 0x6f, 0x6e, 0x22, 0x29, 0x2e, 0x63, 0x6c, 0x69, 0x63,
+  0x6b, 0x28, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x28, 0x29,
+  0x20, 0x7b, 0x0a, 0x20, 0x20, 0x69, 0x66, 0x20, 0x28, 0x73, 0x6f, 0x63,
+  0x6b, 0x65, 0x74, 0x2e, 0x72, 0x65, 0x61, 0x64, 0x79, 0x53, 0x74, 0x61,
+  0x74, 0x65, 0x20, 0x3d, 0x3d, 0x3d, 0x20, 0x57, 0x65, 0x62, 0x53, 0x6f,
+  0x63, 0x6b, 0x65, 0x74, 0x2e, 0x4f, 0x50, 0x45, 0x4e, 0x29, 0x20, 0x7b,
+  0x0a, 0x20, 0x20, 0x20, 0x20, 0x73, 0x6f, 0x63, 0x6b, 0x65, 0x74, 0x2e,
+  0x73, 0x65, 0x6e, 0x64, 0x28, 0x4a, 0x53, 0x4f, 0x4e, 0x2e, 0x73, 0x74,
+  0x72, 0x69, 0x6e, 0x67, 0x69, 0x66, 0x79, 0x28, 0x7b, 0x22, 0x74, 0x22,
+  0x3a, 0x20, 0x70, 0x65, 0x72, 0x66, 0x6f, 0x72, 0x6d, 0x61, 0x6e, 0x63,
+  0x65, 0x2e, 0x6e, 0x6f, 0x77, 0x28, 0x29, 0x7d, 0x29, 0x29, 0x3b, 0x0a,
+  0x20, 0x20, 0x7d, 0x0a, 0x7d, 0x29, 0x3b, 0x0a
 };
-const unsigned int custom_js_len = 66;
+const unsigned int custom_js_len = 1292;
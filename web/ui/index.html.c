@@ -51,36 +51,47 @@ const unsigned char index_html[] = {
   0x6e, 0x20, 0x62, 0x74, 0x6e, 0x2d, 0x70, 0x72, 0x69, 0x6d, 0x61, 0x72,
   0x79, 0x22, 0x3e, 0x50, 0x72, 0x69, 0x6d, 0x61, 0x72, 0x79, 0x3c, 0x2f,
   0x62, 0x75, 0x74, 0x74, 0x6f, 0x6e, 0x3e, 0x0a, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x3c, 0x2f, 0x64, 0x69, 0x76, 0x3e, 0x0a, 0x20, 0x20, 0x20,
-  0x20, 0x3c, 0x2f, 0x73, 0x65, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x3e, 0x0a,
-  0x0a, 0x20, 0x20, 0x20, 0x20, 0x3c, 0x21, 0x2d, 0x2d, 0x20, 0x4f, 0x70,
-  0x74, 0x69, 0x6f, 0x6e, 0x61, 0x6c, 0x20, 0x4a, 0x61, 0x76, 0x61, 0x53,
-  0x63, 0x72, 0x69, 0x70, 0x74, 0x20, 0x2d, 0x2d, 0x3e, 0x0a, 0x20, 0x20,
-  0x20, 0x20, 0x3c, 0x21, 0x2d, 0x2d, 0x20, 0x6a, 0x51, 0x75, 0x65, 0x72,
-  0x79, 0x20, 0x66, 0x69, 0x72, 0x73, 0x74, 0x2c, 0x20, 0x74, 0x68, 0x65,
-  0x6e, 0x20, 0x50, 0x6f, 0x70, 0x70, 0x65, 0x72, 0x2e, 0x6a, 0x73, 0x2c,
-  0x20, 0x74, 0x68, 0x65, 0x6e, 0x20, 0x42, 0x6f, 0x6f, 0x74, 0x73, 0x74,
-  0x72, 0x61, 0x70, 0x20, 0x4a, 0x53, 0x20, 0x2d, 0x2d, 0x3e, 0x0a, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x3c, 0x73, 0x70, 0x61, 0x6e, 0x20, 0x69, 0x64,
+  0x3d, 0x22, 0x72, 0x74, 0x74, 0x22, 0x20, 0x63, 0x6c, 0x61, 0x73, 0x73,
+  0x3d, 0x22, 0x6d, 0x6c, 0x2d, 0x32, 0x22, 0x3e, 0x3c, 0x2f, 0x73, 0x70,
+  0x61, 0x6e, 0x3e, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x3c, 0x2f,
+  0x64, 0x69, 0x76, 0x3e, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x3c, 0x2f, 0x73,
+  0x65, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x3e, 0x0a, 0x0a, 0x20, 0x20, 0x20,
+  0x20, 0x3c, 0x73, 0x65, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x63, 0x6c,
+  0x61, 0x73, 0x73, 0x3d, 0x22, 0x63, 0x6f, 0x6e, 0x74, 0x61, 0x69, 0x6e,
+  0x65, 0x72, 0x22, 0x3e, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x3c,
+  0x63, 0x61, 0x6e, 0x76, 0x61, 0x73, 0x20, 0x69, 0x64, 0x3d, 0x22, 0x74,
+  0x65, 0x6c, 0x65, 0x6d, 0x65, 0x74, 0x72, 0x79, 0x22, 0x3e, 0x3c, 0x2f,
+  0x63, 0x61, 0x6e, 0x76, 0x61, 0x73, 0x3e, 0x0a, 0x20, 0x20, 0x20, 0x20,
+  0x3c, 0x2f, 0x73, 0x65, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x3e, 0x0a, 0x0a,
+  0x20, 0x20, 0x20, 0x20, 0x3c, 0x21, 0x2d, 0x2d, 0x20, 0x4f, 0x70, 0x74,
+  0x69, 0x6f, 0x6e, 0x61, 0x6c, 0x20, 0x4a, 0x61, 0x76, 0x61, 0x53, 0x63,
+  0x72, 0x69, 0x70, 0x74, 0x20, 0x2d, 0x2d, 0x3e, 0x0a, 0x20, 0x20, 0x20,
+  0x20, 0x3c, 0x21, 0x2d, 0x2d, 0x20, 0x6a, 0x51, 0x75, 0x65, 0x72, 0x79,
+  0x20, 0x66, 0x69, 0x72, 0x73, 0x74, 0x2c, 0x20, 0x74, 0x68, 0x65, 0x6e,
+  0x20, 0x50, 0x6f, 0x70, 0x70, 0x65, 0x72, 0x2e, 0x6a, 0x73, 0x2c, 0x20,
+  0x74, 0x68, 0x65, 0x6e, 0x20, 0x42, 0x6f, 0x6f, 0x74, 0x73, 0x74, 0x72,
+  0x61, 0x70, 0x20, 0x4a, 0x53, 0x20, 0x2d, 0x2d, 0x3e, 0x0a, 0x20, 0x20,
+  0x20, 0x20, 0x3c, 0x73, 0x63, 0x72, 0x69, 0x70, 0x74, 0x20, 0x73, 0x72,
+  0x63, 0x3d, 0x22, 0x2f, 0x6a, 0x71, 0x75, 0x65, 0x72, 0x79, 0x2d, 0x33,
+  0x2e, 0x34, 0x2e, 0x31, 0x2e, 0x6d, 0x69, 0x6e, 0x2e, 0x6a, 0x73, 0x22,
+  0x3e, 0x3c, 0x2f, 0x73, 0x63, 0x72, 0x69, 0x70, 0x74, 0x3e, 0x0a, 0x20,
   0x20, 0x20, 0x20, 0x3c, 0x73, 0x63, 0x72, 0x69, 0x70, 0x74, 0x20, 0x73,
-  0x72, 0x63, 0x3d, 0x22, 0x2f, 0x6a, 0x71, 0x75, 0x65, 0x72, 0x79, 0x2d,
-  0x33, 0x2e, 0x34, 0x2e, 0x31, 0x2e, 0x6d, 0x69, 0x6e, 0x2e, 0x6a, 0x73,
-  0x22, 0x3e, 0x3c, 0x2f, 0x73, 0x63, 0x72, 0x69, 0x70, 0x74, 0x3e, 0x0a,
-  0x20, 0x20, 0x20, 0x20, 0x3c, 0x73, 0x63, 0x72, 0x69, 0x70, 0x74, 0x20,
-  0x73, 0x72, 0x63, 0x3d, 0x22, 0x2f, 0x70, 0x6f, 0x70, 0x70, 0x65, 0x72,
-  0x2e, 0x6d, 0x69, 0x6e, 0x2e, 0x6a, 0x73, 0x22, 0x3e, 0x3c, 0x2f, 0x73,
-  0x63, 0x72, 0x69, 0x70, 0x74, 0x3e, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x3c,
-  0x73, 0x63, 0x72, 0x69, 0x70, 0x74, 0x20, 0x73, 0x72, 0x63, 0x3d, 0x22,
-  0x2f, 0x62, 0x6f, 0x6f, 0x74, 0x73, 0x74, 0x72, 0x61, 0x70, 0x2e, 0x6d,
-  0x69, 0x6e, 0x2e, 0x6a, 0x73, 0x22, 0x3e, 0x3c, 0x2f, 0x73, 0x63, 0x72,
-  0x69, 0x70, 0x74, 0x3e, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x3c, 0x73, 0x63,
-  0x72, 0x69, 0x70, 0x74, 0x20, 0x73, 0x72, 0x63, 0x3d, 0x22, 0x2f, 0x43,
-  0x68, 0x61, 0x72, 0x74, 0x2e, 0x62, 0x75, 0x6e, 0x64, 0x6c, 0x65, 0x2e,
+  0x72, 0x63, 0x3d, 0x22, 0x2f, 0x70, 0x6f, 0x70, 0x70, 0x65, 0x72, 0x2e,
   0x6d, 0x69, 0x6e, 0x2e, 0x6a, 0x73, 0x22, 0x3e, 0x3c, 0x2f, 0x73, 0x63,
   0x72, 0x69, 0x70, 0x74, 0x3e, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x3c, 0x73,
   0x63, 0x72, 0x69, 0x70, 0x74, 0x20, 0x73, 0x72, 0x63, 0x3d, 0x22, 0x2f,
-  0x63, 0x75, 0x73, 0x74, 0x6f, 0x6d, 0x2e, 0x6a, 0x73, 0x22, 0x3e, 0x3c,
-  0x2f, 0x73, 0x63, 0x72, 0x69, 0x70, 0x74, 0x3e, 0x0a, 0x0a, 0x20, 0x20,
-  0x3c, 0x2f, 0x62, 0x6f, 0x64, 0x79, 0x3e, 0x0a, 0x3c, 0x2f, 0x68, 0x74,
-  0x6d, 0x6c, 0x3e, 0x0a
+  0x62, 0x6f, 0x6f, 0x74, 0x73, 0x74, 0x72, 0x61, 0x70, 0x2e, 0x6d, 0x69,
+  0x6e, 0x2e, 0x6a, 0x73, 0x22, 0x3e, 0x3c, 0x2f, 0x73, 0x63, 0x72, 0x69,
+  0x70, 0x74, 0x3e, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x3c, 0x73, 0x63, 0x72,
+  0x69, 0x70, 0x74, 0x20, 0x73, 0x72, 0x63, 0x3d, 0x22, 0x2f, 0x43, 0x68,
+  0x61, 0x72, 0x74, 0x2e, 0x62, 0x75, 0x6e, 0x64, 0x6c, 0x65, 0x2e, 0x6d,
+  0x69, 0x6e, 0x2e, 0x6a, 0x73, 0x22, 0x3e, 0x3c, 0x2f, 0x73, 0x63, 0x72,
+  0x69, 0x70, 0x74, 0x3e, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x3c, 0x73, 0x63,
+  0x72, 0x69, 0x70, 0x74, 0x20, 0x73, 0x72, 0x63, 0x3d, 0x22, 0x2f, 0x63,
+  0x75, 0x73, 0x74, 0x6f, 0x6d, 0x2e, 0x6a, 0x73, 0x22, 0x3e, 0x3c, 0x2f,
+  0x73, 0x63, 0x72, 0x69, 0x70, 0x74, 0x3e, 0x0a, 0x0a, 0x20, 0x20, 0x3c,
+  0x2f, 0x62, 0x6f, 0x64, 0x79, 0x3e, 0x0a, 0x3c, 0x2f, 0x68, 0x74, 0x6d,
+  0x6c, 0x3e, 0x0a
 };
-const unsigned int index_html_len = 856;
+const unsigned int index_html_len = 987;
@@ -27,7 +27,9 @@
  */
 
 #define _GNU_SOURCE
+#include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 
 #include "ch.h"
 
@@ -39,23 +41,38 @@
 #include "lwip/api.h"
 
 #include "web.h"
+#include "request.h"
 
 #include "jsmn.h"
 
+#include "events.h"
+#include "json.h"
+#include "ws.h"
+
+#include "boot.h"
+#include "cpu.h"
+#include "metrics.h"
+#include "net.h"
+#include "heap.h"
+#include "inversion.h"
+#include "irq.h"
+#include "locks.h"
+#include "sampler.h"
+#include "stacks.h"
+#include "series.h"
+#include "status.h"
+#include "trace.h"
+
 #include "ui.h"
 
 #if LWIP_NETCONN
 
 #define BUFFER_SIZE 256
-#define HEADER_COUNT 16
-#define HEADER_NAME_SIZE 32
-#define HEADER_VALUE_SIZE 128
+#define JSON_BUFFER_SIZE 2048
 #define JS_VALUE_SIZE 16
-#define REQUEST_BODY_SIZE 1024
-#define REQUEST_URL_SIZE 128
-#define REQUEST_METHOD_SIZE 8
-#define REQUEST_PROTOCOL_SIZE 8
 #define VIEW_PATH_SIZE 128
+#define BATCH_SIZE 8
+#define BATCH_TOKENS 64
 
 #define ARRAY_SIZE(x) (sizeof(x) / sizeof(x[0]))
 
@@ -64,20 +81,6 @@ typedef struct string {
   int len;
 } string_t;
 
-typedef struct header {
-  char *name;
-  char *value;
-  struct header *next;
-} header_t;
-
-typedef struct request {
-  char *method;
-  char *url;
-  char *protocol;
-  header_t *headers;
-  char *body;
-} request_t;
-
 typedef struct response {
   string_t *head;
   string_t *body;
@@ -89,13 +92,37 @@ typedef struct view {
   response_t *response;
 	struct view * (*get_handler)(struct view *);
 	struct view * (*post_handler)(struct view *);
+  /* The handlers write the response to the connection themselves.*/
+  bool streamed;
+  /* The connection is handed to a helper thread and not closed here.*/
+  bool detached;
 } view_t;
 
+typedef view_t * (*handler_t)(view_t *);
+
 typedef struct jspair {
   char *name;
   char *value;
 } jspair_t;
 
+typedef enum {
+  STREAM_EVENTS,
+  STREAM_WEBSOCKET,
+} stream_kind_t;
+
+typedef struct stream {
+  struct netconn *conn;
+  stream_kind_t kind;
+  sysinterval_t interval;
+  char accept[WS_ACCEPT_SIZE];
+} stream_t;
+
+typedef struct batch_op {
+  jsmntok_t *method;
+  jsmntok_t *path;
+  jsmntok_t *body;
+} batch_op_t;
+
 static header_t headers[] = {
   [0 ... (HEADER_COUNT - 1)] = (header_t) {
     .name = (char [HEADER_NAME_SIZE]) {'\0'},
@@ -114,14 +141,22 @@ static string_t *body_buffer = &(string_t) {
   .len = 0,
 };
 
+static string_t *json_buffer = &(string_t) {
+  .data = (char [JSON_BUFFER_SIZE]) {'\0'},
+  .len = 0,
+};
+
 static string_t *file = &(string_t) {
   .data = NULL,
   .len = 0,
 };
 
 static request_t *request = &(request_t) {
+  .conn = NULL,
+  .detached = false,
   .method = (char [REQUEST_METHOD_SIZE]) {'\0'},
   .url = (char [REQUEST_URL_SIZE]) {'\0'},
+  .query = NULL,
   .protocol = (char [REQUEST_PROTOCOL_SIZE]) {'\0'},
   .headers = NULL,
   .body = (char [REQUEST_BODY_SIZE]) {'\0'},
@@ -132,16 +167,56 @@ static response_t *response = &(response_t) {
   .body = NULL,
 };
 
+static char raw_buffer[REQUEST_SIZE];
+
+static const char bad_request[] =
+  "HTTP/1.1 400\r\n"
+  "Connection: close\r\n"
+  "\r\n";
+
+static fields_t fields;
+
+static status_t status_snapshot;
+
+static status_app_t status_app;
+
 static char js[256];
 
 static jsmn_parser p;
 
 static jsmntok_t t[128];
 
+static char profile_user[JS_VALUE_SIZE];
+
+static char batch_js[REQUEST_BODY_SIZE];
+
+static jsmntok_t batch_t[BATCH_TOKENS];
+
+static series_query_t series_request;
+
+static series_bucket_t series_buckets[SERIES_POINTS_MAX];
+
+static irq_stats_t irq_request;
+
+static stacks_peaks_t stacks_request;
+
+#if LOCKS_PROFILE
+static locks_object_t locks_request;
+#endif
+
+#if HEAP_PROFILE
+static heap_stats_t heap_request;
+#endif
+
+static inversion_stats_t inversion_request;
+
+METRIC_COUNTER_DECL(requests_metric, "http_requests_total",
+                    "HTTP requests served.", 1);
+
 static const char *request_header_get(const char * c) {
-  header_t *h = headers;
+  header_t *h = request->headers;
   while (h) {
-    if (memcmp(h->name, c, strlen(c)) == 0) {
+    if (strcasecmp(h->name, c) == 0) {
       return h->value;
     }
     h = h->next;
@@ -149,16 +224,6 @@ static const char *request_header_get(const char * c) {
   return NULL;
 }
 
-static void json_get(const char *raw) {
-  while (*raw != '{' && *raw != '\0') {
-    raw++;
-  }
-
-  size_t json_len = strcspn(raw, "}");
-  memcpy(js, raw, json_len + 1);
-  js[json_len + 1] = '\0';
-}
-
 static int jsoneq(const char *json, jsmntok_t *tok, const char *s) {
   if (tok->type == JSMN_STRING && (int)strlen(s) == tok->end - tok->start &&
       strncmp(json + tok->start, s, tok->end - tok->start) == 0) {
@@ -186,6 +251,96 @@ static view_t *http_handle_static(view_t *view) {
 }
 
 static view_t *http_handle_status(view_t *view) {
+  static const char *states[] = {CH_STATE_NAMES};
+  status_t *status = &status_snapshot;
+  json_t *json = &(json_t) {0};
+
+  head_buffer->len = chsnprintf(head_buffer->data, BUFFER_SIZE,
+    "HTTP/1.1 200\r\n"
+    "Content-Type: application/json\r\n"
+    "Connection: close\r\n"
+    "\r\n"
+  );
+
+  status_read(status);
+
+  json_begin(json, json_buffer->data, JSON_BUFFER_SIZE, &fields);
+
+  json_uint(json, "uptime", TIME_I2MS(chVTGetSystemTimeX()));
+
+  if (json_object_open(json, "heap")) {
+    json_uint(json, "free", status->system.heap_free);
+    json_uint(json, "largest", status->system.heap_largest);
+    json_uint(json, "fragments", status->system.heap_fragments);
+    json_uint(json, "core", status->system.core_free);
+    json_object_close(json);
+  }
+
+  if (json_object_open(json, "load")) {
+    json_float(json, "1s", status->system.load[0] / 10.0f);
+    json_float(json, "10s", status->system.load[1] / 10.0f);
+    json_float(json, "60s", status->system.load[2] / 10.0f);
+    json_object_close(json);
+  }
+
+  if (json_object_open(json, "net")) {
+    char address[16];
+    ip4_addr_t ip;
+    ip4_addr_set_u32(&ip, status->net.address);
+    ip4addr_ntoa_r(&ip, address, sizeof(address));
+
+    json_bool(json, "link", status->net.link);
+    json_bool(json, "up", status->net.up);
+    json_string(json, "address", address);
+    if (json_array_open(json, "pools")) {
+      for (int i = 0; i < status->net.pool_count; i++) {
+        status_pool_t *pool = &status->net.pools[i];
+        if (json_object_open(json, NULL)) {
+          json_string(json, "name", pool->name ? pool->name : "");
+          json_uint(json, "avail", pool->avail);
+          json_uint(json, "used", pool->used);
+          json_uint(json, "max", pool->max);
+          json_uint(json, "err", pool->err);
+          json_object_close(json);
+        }
+      }
+      json_array_close(json);
+    }
+    json_object_close(json);
+  }
+
+  if (json_array_open(json, "threads")) {
+    for (int i = 0; i < status->system.thread_count; i++) {
+      status_thread_t *thread = &status->system.threads[i];
+      if (json_object_open(json, NULL)) {
+        json_string(json, "name", thread->name);
+        json_uint(json, "prio", thread->prio);
+        json_string(json, "state", states[thread->state]);
+        json_object_close(json);
+      }
+    }
+    json_array_close(json);
+  }
+
+  if (json_object_open(json, "app")) {
+    json_uint(json, "requests", status->app.requests);
+    json_string(json, "user", status->app.user);
+    json_object_close(json);
+  }
+
+  json_buffer->len = json_end(json);
+
+  response->head = head_buffer;
+  response->body = json_buffer;
+  view->response = response;
+  return view;
+}
+
+static view_t *http_handle_threads(view_t *view) {
+  static const char *states[] = {CH_STATE_NAMES};
+  status_t *status = &status_snapshot;
+  json_t *json = &(json_t) {0};
+
   head_buffer->len = chsnprintf(head_buffer->data, BUFFER_SIZE,
     "HTTP/1.1 200\r\n"
     "Content-Type: application/json\r\n"
@@ -193,17 +348,422 @@ static view_t *http_handle_status(view_t *view) {
     "\r\n"
   );
 
-  body_buffer->len= chsnprintf(body_buffer->data, BUFFER_SIZE,
-    "Handle Status\r\n"
+  status_read(status);
+
+  json_begin(json, json_buffer->data, JSON_BUFFER_SIZE, &fields);
+
+  json_uint(json, "window", CPU_WINDOW_MS);
+
+  if (json_array_open(json, "threads")) {
+    for (int i = 0; i < status->system.thread_count; i++) {
+      status_thread_t *thread = &status->system.threads[i];
+      if (json_object_open(json, NULL)) {
+        json_string(json, "name", thread->name);
+        json_uint(json, "prio", thread->prio);
+        json_string(json, "state", states[thread->state]);
+        json_uint(json, "mcycles", (unsigned long)(thread->cycles / 1000000));
+        if (json_array_open(json, "load")) {
+          for (int j = 0; j < CPU_LOADS; j++) {
+            json_float(json, NULL, thread->load[j] / 10.0f);
+          }
+          json_array_close(json);
+        }
+        json_object_close(json);
+      }
+    }
+    json_array_close(json);
+  }
+
+  json_buffer->len = json_end(json);
+
+  response->head = head_buffer;
+  response->body = json_buffer;
+  view->response = response;
+  return view;
+}
+
+/* Streams the writer output straight into the connection.*/
+static void http_conn_flush(void *arg, const char *data, size_t len) {
+  netconn_write((struct netconn *)arg, data, len, NETCONN_COPY);
+}
+
+static void http_cycles_histogram(json_t *json, const char *key,
+                               const histogram_t *histogram) {
+  static const struct {
+    const char *key;
+    uint32_t permille;
+  } quantiles[] = {{"p50", 500}, {"p90", 900}, {"p99", 990}};
+  uint32_t mhz = CPU_CYCLES_HZ / 1000000;
+
+  if (json_object_open(json, key)) {
+    json_uint(json, "count", histogram->count);
+    for (size_t i = 0; i < ARRAY_SIZE(quantiles); i++) {
+      uint32_t cycles = histogram_quantile(histogram, quantiles[i].permille);
+      json_uint(json, quantiles[i].key,
+                (unsigned long)((uint64_t)cycles * 1000 / mhz));
+    }
+    json_uint(json, "max",
+              (unsigned long)((uint64_t)histogram->max * 1000 / mhz));
+    json_object_close(json);
+  }
+}
+
+static view_t *http_irq_render(view_t *view, bool reset) {
+  json_t *json = &(json_t) {0};
+
+  head_buffer->len = chsnprintf(head_buffer->data, BUFFER_SIZE,
+    "HTTP/1.1 200\r\n"
+    "Content-Type: application/json\r\n"
+    "Connection: close\r\n"
+    "\r\n"
   );
 
+  json_begin(json, json_buffer->data, JSON_BUFFER_SIZE, &fields);
+
+  if (json_array_open(json, "vectors")) {
+    for (int i = 0; irq_read(i, &irq_request, reset); i++) {
+      if (json_object_open(json, NULL)) {
+        json_uint(json, "vector", irq_request.vector);
+        http_cycles_histogram(json, "duration", &irq_request.duration);
+        http_cycles_histogram(json, "latency", &irq_request.latency);
+        json_object_close(json);
+      }
+    }
+    json_array_close(json);
+  }
+
+  json_buffer->len = json_end(json);
+
   response->head = head_buffer;
-  response->body = body_buffer;
+  response->body = json_buffer;
   view->response = response;
   return view;
 }
 
-static view_t *http_handle_profile_get(view_t *view) {
+/**
+ * @brief Returns the interrupt duration and latency quantiles in ns.
+ */
+static view_t *http_handle_irq_get(view_t *view) {
+  return http_irq_render(view, false);
+}
+
+/**
+ * @brief Same as GET, the histograms are cleared after being read.
+ */
+static view_t *http_handle_irq_post(view_t *view) {
+  return http_irq_render(view, true);
+}
+
+static view_t *http_locks_render(view_t *view, bool reset) {
+  json_t *json = &(json_t) {0};
+
+  (void)view;
+
+  head_buffer->len = chsnprintf(head_buffer->data, BUFFER_SIZE,
+    "HTTP/1.1 200\r\n"
+    "Content-Type: application/json\r\n"
+    "Connection: close\r\n"
+    "\r\n"
+  );
+  netconn_write(request->conn, head_buffer->data, head_buffer->len,
+                NETCONN_COPY);
+
+  json_begin(json, json_buffer->data, JSON_BUFFER_SIZE, &fields);
+  json_sink(json, http_conn_flush, request->conn);
+
+  json_bool(json, "enabled", LOCKS_PROFILE);
+#if LOCKS_PROFILE
+  json_uint(json, "dropped", locks_dropped());
+#else
+  (void)reset;
+  json_uint(json, "dropped", 0);
+#endif
+  if (json_array_open(json, "locks")) {
+#if LOCKS_PROFILE
+    static const char *kinds[] = {"mutex", "semaphore", "mailbox"};
+    locks_object_t *lock = &locks_request;
+    int order[LOCKS_OBJECTS];
+    int count = locks_rank(order);
+
+    for (int i = 0; i < count && locks_read(order[i], lock, reset); i++) {
+      if (json_object_open(json, NULL)) {
+        char address[12];
+        chsnprintf(address, sizeof(address), "0x%08lx",
+                   (uint32_t)lock->object);
+        json_string(json, "name", lock->name ? lock->name : address);
+        json_string(json, "kind", kinds[lock->kind]);
+        json_uint(json, "acquires", lock->acquires);
+        json_uint(json, "contended", lock->contended);
+        http_cycles_histogram(json, "wait", &lock->wait);
+        http_cycles_histogram(json, "hold", &lock->hold);
+        if (json_array_open(json, "contenders")) {
+          for (int j = 0; j < LOCKS_CONTENDERS &&
+                          lock->contenders[j].count > 0; j++) {
+            if (json_object_open(json, NULL)) {
+              json_string(json, "thread", lock->contenders[j].name ?
+                                          lock->contenders[j].name : "");
+              json_uint(json, "count", lock->contenders[j].count);
+              json_object_close(json);
+            }
+          }
+          json_array_close(json);
+        }
+        json_object_close(json);
+      }
+    }
+#endif
+    json_array_close(json);
+  }
+
+  json_end(json);
+  json_flush(json);
+  return NULL;
+}
+
+/**
+ * @brief Returns the locks by total wait, times in ns, streamed.
+ * @details Empty unless built with USE_LOCKS_PROFILE=yes.
+ */
+static view_t *http_handle_locks_get(view_t *view) {
+  return http_locks_render(view, false);
+}
+
+/**
+ * @brief Same as GET, the statistics are cleared after being read.
+ */
+static view_t *http_handle_locks_post(view_t *view) {
+  return http_locks_render(view, true);
+}
+
+static void http_boot_record(json_t *json, const char *key,
+                             const boot_record_t *record) {
+  static const char *stages[] = {BOOT_STAGE_NAMES};
+  static const char *causes[] = {BOOT_CAUSE_NAMES};
+
+  if (!json_object_open(json, key)) {
+    return;
+  }
+  json_uint(json, "count", record->count);
+  if (json_array_open(json, "cause")) {
+    for (unsigned int i = 0; i < ARRAY_SIZE(causes); i++) {
+      if (record->cause & (1U << i)) {
+        json_string(json, NULL, causes[i]);
+      }
+    }
+    json_array_close(json);
+  }
+  if (json_object_open(json, "us")) {
+    for (int i = 0; i < BOOT_STAGES; i++) {
+      if (record->reached & (1U << i)) {
+        json_uint(json, stages[i], record->us[i]);
+      }
+    }
+    json_object_close(json);
+  }
+  json_object_close(json);
+}
+
+/**
+ * @brief Returns the boot stage times of this boot and of the boot before
+ *        the last reset, in us from the start of main().
+ * @details Stages not reached are left out, so is "previous" when the
+ *          backup SRAM held no record.
+ */
+static view_t *http_handle_boot(view_t *view) {
+  boot_record_t *current = &(boot_record_t) {0};
+  boot_record_t *previous = &(boot_record_t) {0};
+  json_t *json = &(json_t) {0};
+
+  head_buffer->len = chsnprintf(head_buffer->data, BUFFER_SIZE,
+    "HTTP/1.1 200\r\n"
+    "Content-Type: application/json\r\n"
+    "Connection: close\r\n"
+    "\r\n"
+  );
+
+  json_begin(json, json_buffer->data, JSON_BUFFER_SIZE, &fields);
+
+  if (boot_read(current, previous)) {
+    http_boot_record(json, "previous", previous);
+  }
+  http_boot_record(json, "current", current);
+
+  json_buffer->len = json_end(json);
+
+  response->head = head_buffer;
+  response->body = json_buffer;
+  view->response = response;
+  return view;
+}
+
+static view_t *http_heap_render(view_t *view, bool reset) {
+  json_t *json = &(json_t) {0};
+  size_t free, largest;
+  uint32_t fragmentation;
+
+  (void)view;
+
+  head_buffer->len = chsnprintf(head_buffer->data, BUFFER_SIZE,
+    "HTTP/1.1 200\r\n"
+    "Content-Type: application/json\r\n"
+    "Connection: close\r\n"
+    "\r\n"
+  );
+  netconn_write(request->conn, head_buffer->data, head_buffer->len,
+                NETCONN_COPY);
+
+  fragmentation = heap_fragmentation(&free, &largest);
+
+  json_begin(json, json_buffer->data, JSON_BUFFER_SIZE, &fields);
+  json_sink(json, http_conn_flush, request->conn);
+
+  json_bool(json, "enabled", HEAP_PROFILE);
+  json_uint(json, "free", free);
+  json_uint(json, "largest", largest);
+  json_fixed(json, "fragmentation", fragmentation / 1000,
+             fragmentation % 1000);
+#if HEAP_PROFILE
+  static const char *kinds[] = {"heap", "core", "lwip"};
+  heap_stats_t *stats = &heap_request;
+
+  heap_read(stats, reset);
+  json_uint(json, "dropped", stats->dropped);
+  json_uint(json, "untracked", stats->untracked);
+  if (json_array_open(json, "sites")) {
+    for (int i = 0; i < stats->sites_count; i++) {
+      heap_site_t *hs = &stats->sites[i];
+      if (json_object_open(json, NULL)) {
+        char site[12];
+        chsnprintf(site, sizeof(site), "0x%08lx", (uint32_t)hs->site);
+        json_string(json, "site", site);
+        json_string(json, "kind", kinds[hs->kind]);
+        json_uint(json, "count", hs->count);
+        json_uint(json, "bytes", hs->bytes);
+        json_uint(json, "live", hs->live);
+        json_uint(json, "peak", hs->peak);
+        json_uint(json, "failed", hs->failed);
+        json_object_close(json);
+      }
+    }
+    json_array_close(json);
+  }
+#else
+  (void)reset;
+  json_uint(json, "dropped", 0);
+  json_uint(json, "untracked", 0);
+  if (json_array_open(json, "sites")) {
+    json_array_close(json);
+  }
+#endif
+
+  json_end(json);
+  json_flush(json);
+  return NULL;
+}
+
+/**
+ * @brief Returns the allocations by call site and the heap fragmentation,
+ *        streamed.
+ * @details The sites are empty unless built with USE_HEAP_PROFILE=yes.
+ */
+static view_t *http_handle_heap_get(view_t *view) {
+  return http_heap_render(view, false);
+}
+
+/**
+ * @brief Same as GET, the site counters and peaks are reset after being read.
+ */
+static view_t *http_handle_heap_post(view_t *view) {
+  return http_heap_render(view, true);
+}
+
+static void http_inversion_thread(json_t *json, const char *key,
+                                  const char *name, tprio_t prio) {
+  if (json_object_open(json, key)) {
+    json_string(json, "name", name ? name : "");
+    json_uint(json, "prio", prio);
+    json_object_close(json);
+  }
+}
+
+static view_t *http_inversions_render(view_t *view, bool reset) {
+  inversion_stats_t *stats = &inversion_request;
+  json_t *json = &(json_t) {0};
+  uint32_t mhz = CPU_CYCLES_HZ / 1000000;
+
+  (void)view;
+
+  head_buffer->len = chsnprintf(head_buffer->data, BUFFER_SIZE,
+    "HTTP/1.1 200\r\n"
+    "Content-Type: application/json\r\n"
+    "Connection: close\r\n"
+    "\r\n"
+  );
+  netconn_write(request->conn, head_buffer->data, head_buffer->len,
+                NETCONN_COPY);
+
+  inversion_read(stats, reset);
+
+  json_begin(json, json_buffer->data, JSON_BUFFER_SIZE, &fields);
+  json_sink(json, http_conn_flush, request->conn);
+
+  json_uint(json, "count", stats->count);
+  json_uint(json, "inverted_us", (unsigned long)(stats->inverted / mhz));
+  json_uint(json, "max_us", stats->max / mhz);
+  if (json_array_open(json, "events")) {
+    for (int i = 0; i < stats->events_count; i++) {
+      inversion_event_t *event = &stats->events[i];
+      if (json_object_open(json, NULL)) {
+        char object[12];
+        chsnprintf(object, sizeof(object), "0x%08lx", (uint32_t)event->object);
+        json_uint(json, "time", TIME_I2MS(event->time));
+        json_string(json, "object", object);
+        http_inversion_thread(json, "waiter", event->waiter,
+                              event->waiter_prio);
+        http_inversion_thread(json, "server", event->server,
+                              event->server_prio);
+        http_inversion_thread(json, "preemptor", event->preemptor,
+                              event->preemptor_prio);
+        json_uint(json, "blocked_us", event->blocked / mhz);
+        json_uint(json, "inverted_us", event->inverted / mhz);
+        json_object_close(json);
+      }
+    }
+    json_array_close(json);
+  }
+
+  json_end(json);
+  json_flush(json);
+  return NULL;
+}
+
+/**
+ * @brief Returns the recent priority inversions, oldest first, streamed.
+ * @details Each event is the chain waiter > server < preemptor, where the
+ *          waiter blocked on @p object was served by a lower priority
+ *          thread preempted by one still below the waiter.
+ */
+static view_t *http_handle_inversions_get(view_t *view) {
+  return http_inversions_render(view, false);
+}
+
+/**
+ * @brief Same as GET, the counters and events are cleared after being read.
+ */
+static view_t *http_handle_inversions_post(view_t *view) {
+  return http_inversions_render(view, true);
+}
+
+/**
+ * @brief Returns the stack usage of each thread in bytes.
+ * @details "peaks" also lists exited threads, usage is only known for
+ *          painted stacks.
+ */
+static view_t *http_handle_stacks(view_t *view) {
+  stacks_peaks_t *peaks = &stacks_request;
+  json_t *json = &(json_t) {0};
+  thread_t *tp;
+
   head_buffer->len = chsnprintf(head_buffer->data, BUFFER_SIZE,
     "HTTP/1.1 200\r\n"
     "Content-Type: application/json\r\n"
@@ -211,17 +771,74 @@ static view_t *http_handle_profile_get(view_t *view) {
     "\r\n"
   );
 
-  body_buffer->len= chsnprintf(body_buffer->data, BUFFER_SIZE,
-    "Profile Get\r\n"
+  json_begin(json, json_buffer->data, JSON_BUFFER_SIZE, &fields);
+
+  if (json_array_open(json, "threads")) {
+    tp = chRegFirstThread();
+    while (tp) {
+      stacks_usage_t usage;
+      if (json_object_open(json, NULL)) {
+        bool painted = stacks_usage(tp, &usage);
+        json_string(json, "name", tp->name ? tp->name : "");
+        json_bool(json, "painted", painted);
+        if (painted) {
+          json_uint(json, "size", usage.size);
+          json_uint(json, "used", usage.used);
+          json_bool(json, "low", usage.size - usage.used < STACKS_MARGIN);
+        }
+        json_object_close(json);
+      }
+      tp = chRegNextThread(tp);
+    }
+    json_array_close(json);
+  }
+
+  stacks_read(peaks);
+  if (json_array_open(json, "peaks")) {
+    for (int i = 0; i < peaks->count; i++) {
+      stacks_peak_t *peak = &peaks->peaks[i];
+      if (json_object_open(json, NULL)) {
+        json_string(json, "name", peak->name ? peak->name : "");
+        json_uint(json, "size", peak->size);
+        json_uint(json, "used", peak->used);
+        json_uint(json, "time", TIME_I2MS(peak->time));
+        json_object_close(json);
+      }
+    }
+    json_array_close(json);
+  }
+
+  json_buffer->len = json_end(json);
+
+  response->head = head_buffer;
+  response->body = json_buffer;
+  view->response = response;
+  return view;
+}
+
+static view_t *http_handle_profile_get(view_t *view) {
+  json_t *json = &(json_t) {0};
+
+  head_buffer->len = chsnprintf(head_buffer->data, BUFFER_SIZE,
+    "HTTP/1.1 200\r\n"
+    "Content-Type: application/json\r\n"
+    "Connection: close\r\n"
+    "\r\n"
   );
 
+  json_begin(json, json_buffer->data, JSON_BUFFER_SIZE, &fields);
+  json_string(json, "user", profile_user);
+  json_buffer->len = json_end(json);
+
   response->head = head_buffer;
-  response->body = body_buffer;
+  response->body = json_buffer;
   view->response = response;
   return view;
 }
 
 static view_t *http_handle_profile_post(view_t *view) {
+  json_t *json = &(json_t) {0};
+
   head_buffer->len = chsnprintf(head_buffer->data, BUFFER_SIZE,
     "HTTP/1.1 200\r\n"
     "Content-Type: application/json\r\n"
@@ -230,7 +847,7 @@ static view_t *http_handle_profile_post(view_t *view) {
   );
 
 
-  json_get(request->body);
+  json_get(js, sizeof(js), request->body);
 
   jsmn_init(&p);
   int r = jsmn_parse(&p, js, strlen(js), t, ARRAY_SIZE(t));
@@ -240,27 +857,35 @@ static view_t *http_handle_profile_post(view_t *view) {
     .value = (char [JS_VALUE_SIZE]) {'\0'},
   };
 
-  for (int i=0; i<r; i++) {
+  for (int i=0; i<r - 1; i++) {
     if (jsoneq(js, &t[i], pair->name) == 0) {
-      memcpy(pair->value, (js + t[i + 1].start), (t[i + 1].end - t[i + 1].start));
-      pair->value[(t[i + 1].end - t[i + 1].start)] = '\0';
+      /* Stored decoded, it is escaped again on output.*/
+      json_unescape(pair->value, JS_VALUE_SIZE, js + t[i + 1].start,
+                    t[i + 1].end - t[i + 1].start);
+      strcpy(profile_user, pair->value);
       i++;
     }
   }
-  body_buffer->len= chsnprintf(body_buffer->data, BUFFER_SIZE,
-    "{"
-    "\"%s\": \"%s\""
-    "}"
-    ,pair->name
-    ,pair->value
-  );
+
+  json_begin(json, json_buffer->data, JSON_BUFFER_SIZE, &fields);
+  json_string(json, pair->name, pair->value);
+  json_buffer->len = json_end(json);
 
   response->head = head_buffer;
-  response->body = body_buffer;
+  response->body = json_buffer;
   view->response = response;
   return view;
 }
 
+static view_t *http_handle_batch(view_t *view);
+static view_t *http_handle_events(view_t *view);
+static view_t *http_handle_ws(view_t *view);
+static view_t *http_handle_series(view_t *view);
+static view_t *http_handle_metrics(view_t *view);
+static view_t *http_handle_trace(view_t *view);
+static view_t *http_handle_samples_get(view_t *view);
+static view_t *http_handle_samples_post(view_t *view);
+
 extern file_t file_index_html;
 extern file_t file_bootstrap_min_css;
 extern file_t file_bootstrap_min_js;
@@ -323,115 +948,816 @@ static view_t views[] = {
     .get_handler = http_handle_status,
     .post_handler = NULL,
   },
-};
-
-void request_parse(const char *raw) {
-  size_t method_len = strcspn(raw, " ");
-  if (memcmp(raw, "GET", strlen("GET")) == 0) {
-    memcpy(request->method, "GET", strlen("GET"));
-    request->method[method_len] = '\0';
-  } else if (memcmp(raw, "POST", strlen("POST")) == 0) {
-    memcpy(request->method, "POST", strlen("POST"));
-    request->method[method_len] = '\0';
-  }
-  raw += method_len + 1;
-
-  size_t url_len = strcspn(raw, " ");
-  memcpy(request->url, raw, url_len);
-  request->url[url_len] = '\0';
-  raw += url_len + 1;
-
-  size_t protocol_len = strcspn(raw, "\r\n");
-  if (memcmp(raw, "HTTP/1.0", strlen("HTTP/1.0")) == 0) {
-    memcpy(request->protocol, "HTTP/1.0", strlen("HTTP/1.0"));
-    request->protocol[protocol_len] = '\0';
-  } else if (memcmp(raw, "HTTP/1.1", strlen("HTTP/1.1")) == 0) {
-    memcpy(request->protocol, "HTTP/1.1", strlen("HTTP/1.1"));
-    request->protocol[protocol_len] = '\0';
-  } else if (memcmp(raw, "HTTP/2.0", strlen("HTTP/2.0")) == 0) {
-    memcpy(request->protocol, "HTTP/2.0", strlen("HTTP/2.0"));
-    request->protocol[protocol_len] = '\0';
-  }
-  raw += protocol_len + 2;
-
-  int i = 0;
-  while (raw[0]!='\r' || raw[1]!='\n') {
-    size_t name_len = strcspn(raw, ":");
-    memcpy(headers[i].name, raw, name_len);
-    headers[i].name[name_len] = '\0';
-    raw += name_len + 1;
-
-    while (*raw == ' ') {
-      raw++;
-    }
-
-    size_t value_len = strcspn(raw, "\r\n");
-    memcpy(headers[i].value, raw, value_len);
-    headers[i].value[value_len] = '\0';
-    raw += value_len + 2;
-
-    headers[i].next = NULL;
-    if (i > 0) {
-      headers[i-1].next = &headers[i];
-    }
-
-    i++;
-  }
-  raw += 2;
-
-  request->headers = headers;
+  {
+    .path = "/batch",
+    .file = NULL,
+    .get_handler = NULL,
+    .post_handler = http_handle_batch,
+    .streamed = true,
+  },
+  {
+    .path = "/events",
+    .file = NULL,
+    .get_handler = http_handle_events,
+    .post_handler = NULL,
+    .streamed = true,
+    .detached = true,
+  },
+  {
+    .path = "/ws",
+    .file = NULL,
+    .get_handler = http_handle_ws,
+    .post_handler = NULL,
+    .streamed = true,
+    .detached = true,
+  },
+  {
+    .path = "/series",
+    .file = NULL,
+    .get_handler = http_handle_series,
+    .post_handler = NULL,
+    .streamed = true,
+  },
+  {
+    .path = "/metrics",
+    .file = NULL,
+    .get_handler = http_handle_metrics,
+    .post_handler = NULL,
+    .streamed = true,
+  },
+  {
+    .path = "/threads",
+    .file = NULL,
+    .get_handler = http_handle_threads,
+    .post_handler = NULL,
+  },
+  {
+    .path = "/trace",
+    .file = NULL,
+    .get_handler = http_handle_trace,
+    .post_handler = NULL,
+    .streamed = true,
+  },
+  {
+    .path = "/irq",
+    .file = NULL,
+    .get_handler = http_handle_irq_get,
+    .post_handler = http_handle_irq_post,
+  },
+  {
+    .path = "/stacks",
+    .file = NULL,
+    .get_handler = http_handle_stacks,
+    .post_handler = NULL,
+  },
+  {
+    .path = "/locks",
+    .file = NULL,
+    .get_handler = http_handle_locks_get,
+    .post_handler = http_handle_locks_post,
+    .streamed = true,
+  },
+  {
+    .path = "/boot",
+    .file = NULL,
+    .get_handler = http_handle_boot,
+    .post_handler = NULL,
+  },
+  {
+    .path = "/heap",
+    .file = NULL,
+    .get_handler = http_handle_heap_get,
+    .post_handler = http_handle_heap_post,
+    .streamed = true,
+  },
+  {
+    .path = "/samples",
+    .file = NULL,
+    .get_handler = http_handle_samples_get,
+    .post_handler = http_handle_samples_post,
+    .streamed = true,
+  },
+  {
+    .path = "/inversions",
+    .file = NULL,
+    .get_handler = http_handle_inversions_get,
+    .post_handler = http_handle_inversions_post,
+    .streamed = true,
+  },
+};
+
+/* Latency summary of each view and, last, of the requests not routed.
+   Static files are not recorded and detached views do not close here,
+   their summaries are not registered.*/
+#define ROUTE_SUMMARIES (ARRAY_SIZE(views) + 1)
+
+static histogram_t route_histograms[ROUTE_SUMMARIES];
+
+static metric_t route_metrics[ROUTE_SUMMARIES];
+
+static histogram_t phase_histograms[HTTP_MARKS - 1];
+
+static metric_t phase_metrics[HTTP_MARKS - 1];
+
+static void http_mark(http_mark_t mark) {
+  request->marks[mark] = CPU_CYCLES();
+}
+
+static void http_latency_register(void) {
+  static const char *phases[] = {"recv", "parse", "handler", "write",
+                                 "close"};
+
+  for (unsigned int i = 0; i < ROUTE_SUMMARIES; i++) {
+    bool routed = i < ARRAY_SIZE(views);
+
+    if (routed && (views[i].file != NULL || views[i].detached)) {
+      continue;
+    }
+    route_metrics[i] = (metric_t) {
+      .name = "http_request_duration_microseconds",
+      .help = "Time from the accept to the close, by route.",
+      .type = METRIC_SUMMARY,
+      .label_name = "route",
+      .label_value = routed ? views[i].path : "unrouted",
+      .shards = 1,
+      .histograms = &route_histograms[i],
+    };
+    metrics_register(&route_metrics[i]);
+  }
+  for (unsigned int i = 0; i < ARRAY_SIZE(phase_metrics); i++) {
+    phase_metrics[i] = (metric_t) {
+      .name = "http_request_phase_microseconds",
+      .help = "Time spent in each phase of the requests.",
+      .type = METRIC_SUMMARY,
+      .label_name = "phase",
+      .label_value = phases[i],
+      .shards = 1,
+      .histograms = &phase_histograms[i],
+    };
+    metrics_register(&phase_metrics[i]);
+  }
+}
+
+/* Records the marks of a request that was served and closed.*/
+static void http_latency_observe(void) {
+  uint32_t *marks = request->marks;
+  uint32_t mhz = CPU_CYCLES_HZ / 1000000;
+
+  for (int i = 0; i < HTTP_MARKS - 1; i++) {
+    metric_observe(&phase_metrics[i], (marks[i + 1] - marks[i]) / mhz);
+  }
+  if (route_metrics[request->route].histograms != NULL) {
+    metric_observe(&route_metrics[request->route],
+                   (marks[HTTP_MARK_CLOSED] - marks[HTTP_MARK_ACCEPTED]) / mhz);
+  }
+}
+
+/**
+ * @brief Looks up the view and handler for the current request.
+ * @return The HTTP status, 200 if @p viewp and @p handlerp are valid.
+ */
+static int http_route(view_t **viewp, handler_t *handlerp) {
+  for (unsigned int i = 0; i < ARRAY_SIZE(views); i++) {
+    if (strcmp(request->url, views[i].path) == 0) {
+      handler_t handler = NULL;
+      if (strcmp(request->method, "GET") == 0) {
+        handler = views[i].get_handler;
+      }
+      if (strcmp(request->method, "POST") == 0) {
+        handler = views[i].post_handler;
+      }
+      if (handler == NULL) {
+        return 405;
+      }
+      *viewp = &views[i];
+      *handlerp = handler;
+      return 200;
+    }
+  }
+  return 404;
+}
+
+static void http_write_status(struct netconn *conn, int status) {
+  head_buffer->len = chsnprintf(head_buffer->data, BUFFER_SIZE,
+    "HTTP/1.1 %d\r\n"
+    "Connection: close\r\n"
+    "\r\n"
+    ,status
+  );
+  netconn_write(conn, head_buffer->data, head_buffer->len, NETCONN_COPY);
+}
+
+static void http_dispatch(struct netconn *conn) {
+  view_t *view;
+  handler_t handler;
+
+  int status = http_route(&view, &handler);
+  if (status != 200) {
+    http_mark(HTTP_MARK_HANDLED);
+    http_write_status(conn, status);
+    http_mark(HTTP_MARK_WRITTEN);
+    return;
+  }
+  request->route = view - views;
+
+  fields_parse(&fields, request->query);
+
+  /* Streamed responses are written by the handler itself.*/
+  view = handler(view);
+  http_mark(HTTP_MARK_HANDLED);
+  if (view) {
+    netconn_write(conn,
+                  view->response->head->data,
+                  view->response->head->len,
+                  NETCONN_NOCOPY);
+    netconn_write(conn,
+                  view->response->body->data,
+                  view->response->body->len,
+                  NETCONN_NOCOPY);
+  }
+  http_mark(HTTP_MARK_WRITTEN);
+}
+
+/* Index of the first token after token i and its children.*/
+static int batch_skip(int i, int r) {
+  int end = batch_t[i].end;
+  for (i++; i < r && batch_t[i].start < end; i++) {
+  }
+  return i;
+}
+
+/* Loads a sub-request into the request structure.*/
+static bool batch_prepare(const batch_op_t *op) {
+  if (op->method == NULL || op->path == NULL ||
+      !token_copy(request->method, REQUEST_METHOD_SIZE,
+                  batch_js + op->method->start,
+                  op->method->end - op->method->start) ||
+      !token_copy(request->url, REQUEST_URL_SIZE,
+                  batch_js + op->path->start,
+                  op->path->end - op->path->start)) {
+    return false;
+  }
+  request_query_split(request);
+
+  request->body[0] = '\0';
+  if (op->body) {
+    field_copy(request->body, REQUEST_BODY_SIZE,
+               batch_js + op->body->start,
+               op->body->end - op->body->start);
+  }
+  return true;
+}
+
+/* Only views answered from the response buffers are batched, their bodies
+   are JSON.*/
+static int batch_route(const batch_op_t *op, view_t **viewp,
+                       handler_t *handlerp) {
+  if (!batch_prepare(op)) {
+    return 400;
+  }
+  int status = http_route(viewp, handlerp);
+  if (status == 200 &&
+      ((*viewp)->file != NULL || (*viewp)->streamed)) {
+    return 400;
+  }
+  return status;
+}
+
+/**
+ * @brief Executes an array of sub-requests through the route table.
+ * @details The body is [{"method": "GET", "path": "/status?fields=heap"},
+ *          {"method": "POST", "path": "/profile", "body": {...}}], the
+ *          response is an array of {"status": 200, "body": ...} in the same
+ *          order. ?atomic=1 gives all-or-none routing: every sub-request
+ *          is routed first and none is executed unless all of them can be.
+ *          It is not a transaction, a handler that runs is not rolled back
+ *          when a later one fails.
+ */
+static view_t *http_handle_batch(view_t *view) {
+  struct netconn *conn = request->conn;
+  batch_op_t ops[BATCH_SIZE];
+  int status[BATCH_SIZE];
+  char atomic[4];
+  handler_t handler;
+  int count, r;
+
+  (void)view;
+
+  query_get(request->query, "atomic", atomic, sizeof(atomic));
+
+  field_copy(batch_js, sizeof(batch_js), request->body, strlen(request->body));
+  jsmn_init(&p);
+  r = jsmn_parse(&p, batch_js, strlen(batch_js), batch_t, ARRAY_SIZE(batch_t));
+  if (r < 1 || batch_t[0].type != JSMN_ARRAY || batch_t[0].size > BATCH_SIZE) {
+    http_write_status(conn, 400);
+    return NULL;
+  }
+
+  count = batch_t[0].size;
+  for (int i = 0, j = 1; i < count; i++) {
+    int end = batch_skip(j, r);
+
+    ops[i] = (batch_op_t) {NULL, NULL, NULL};
+    if (batch_t[j].type == JSMN_OBJECT) {
+      for (int k = j + 1; k + 1 < end; k = batch_skip(k + 1, r)) {
+        if (jsoneq(batch_js, &batch_t[k], "method") == 0) {
+          ops[i].method = &batch_t[k + 1];
+        } else if (jsoneq(batch_js, &batch_t[k], "path") == 0) {
+          ops[i].path = &batch_t[k + 1];
+        } else if (jsoneq(batch_js, &batch_t[k], "body") == 0) {
+          ops[i].body = &batch_t[k + 1];
+        }
+      }
+    }
+    j = end;
+  }
+
+  bool failed = false;
+  if (atomic[0] == '1') {
+    for (int i = 0; i < count; i++) {
+      status[i] = batch_route(&ops[i], &view, &handler);
+      failed |= (status[i] != 200);
+    }
+    for (int i = 0; failed && i < count; i++) {
+      if (status[i] == 200) {
+        status[i] = 424;
+      }
+    }
+  }
+
+  head_buffer->len = chsnprintf(head_buffer->data, BUFFER_SIZE,
+    "HTTP/1.1 200\r\n"
+    "Content-Type: application/json\r\n"
+    "Connection: close\r\n"
+    "\r\n"
+    "["
+  );
+  netconn_write(conn, head_buffer->data, head_buffer->len, NETCONN_COPY);
+
+  for (int i = 0; i < count; i++) {
+    if (!failed) {
+      status[i] = batch_route(&ops[i], &view, &handler);
+    }
+    if (status[i] == 200 && !failed) {
+      fields_parse(&fields, request->query);
+      view = handler(view);
+    }
+
+    head_buffer->len = chsnprintf(head_buffer->data, BUFFER_SIZE,
+      "%s{\"status\": %d%s"
+      ,i > 0 ? "," : ""
+      ,status[i]
+      ,(status[i] == 200 && !failed && view) ? ", \"body\": " : ""
+    );
+    netconn_write(conn, head_buffer->data, head_buffer->len, NETCONN_COPY);
+    if (status[i] == 200 && !failed && view) {
+      netconn_write(conn,
+                    view->response->body->data,
+                    view->response->body->len,
+                    NETCONN_COPY);
+    }
+    netconn_write(conn, "}", 1, NETCONN_NOCOPY);
+  }
+  netconn_write(conn, "]", 1, NETCONN_NOCOPY);
+
+  return NULL;
+}
+
+mailbox_t mb[WEB_HELPER_THREADS];
+msg_t b[WEB_HELPER_THREADS][WEB_MAILBOX_SIZE];
+static stream_t streams[WEB_HELPER_THREADS];
+static bool helper_idle[WEB_HELPER_THREADS];
+
+/**
+ * @brief Hands the current connection over to an idle helper thread.
+ * @return false if all helpers are busy.
+ */
+static bool http_handoff(stream_kind_t kind, sysinterval_t interval,
+                         const char *accept) {
+  int i;
+
+  chSysLock();
+  for (i = 0; i < WEB_HELPER_THREADS; i++) {
+    if (helper_idle[i]) {
+      helper_idle[i] = false;
+      break;
+    }
+  }
+  chSysUnlock();
+
+  if (i == WEB_HELPER_THREADS) {
+    return false;
+  }
+
+  streams[i].conn = request->conn;
+  streams[i].kind = kind;
+  streams[i].interval = interval;
+  if (accept) {
+    memcpy(streams[i].accept, accept, WS_ACCEPT_SIZE);
+  }
+  chMBPostTimeout(&mb[i], (msg_t)&streams[i], TIME_INFINITE);
+  request->detached = true;
+  return true;
+}
+
+/**
+ * @brief Opens a text/event-stream of telemetry frames.
+ * @details ?interval=ms selects the rate, frames are produced at the
+ *          status sampling rate so shorter intervals are rounded up to it.
+ */
+static view_t *http_handle_events(view_t *view) {
+  char value[12];
+  unsigned long interval;
+
+  (void)view;
+
+  query_get(request->query, "interval", value, sizeof(value));
+  interval = strtoul(value, NULL, 10);
+  if (interval == 0) {
+    interval = EVENTS_INTERVAL_MS;
+  }
+
+  if (!http_handoff(STREAM_EVENTS, TIME_MS2I(interval), NULL)) {
+    http_write_status(request->conn, 503);
+  }
+  return NULL;
+}
+
+/* Messages from any socket are relayed to all of them.*/
+static void http_ws_message(const uint8_t *data, size_t len) {
+  ws_broadcast(data, len);
+}
+
+/**
+ * @brief Upgrades the connection to a WebSocket.
+ */
+static view_t *http_handle_ws(view_t *view) {
+  const char *upgrade = request_header_get("Upgrade");
+  const char *key = request_header_get("Sec-WebSocket-Key");
+  char accept[WS_ACCEPT_SIZE];
+
+  (void)view;
+
+  if (upgrade == NULL || strcasecmp(upgrade, "websocket") != 0 ||
+      key == NULL) {
+    http_write_status(request->conn, 400);
+    return NULL;
+  }
+
+  /* The helper answers the handshake, it owns the socket from then on.*/
+  ws_accept(key, accept);
+  if (!http_handoff(STREAM_WEBSOCKET, 0, accept)) {
+    http_write_status(request->conn, 503);
+  }
+  return NULL;
+}
+
+static void http_series_point(void *arg, const series_point_t *point) {
+  json_t *json = arg;
+
+  if (json_array_open(json, NULL)) {
+    json_uint(json, NULL, point->time);
+    json_float(json, NULL, point->value);
+    if (series_request.mode == SERIES_BUCKETS) {
+      json_float(json, NULL, point->min);
+      json_float(json, NULL, point->max);
+    }
+    json_array_close(json);
+  }
+}
+
+/**
+ * @brief Returns a series downsampled to a number of points.
+ * @details ?name=heap&from=ms&to=ms&points=n&mode=buckets|lttb, points are
+ *          [time, avg, min, max] per bucket or [time, value] with lttb.
+ *          "period" is the rollup period scanned, 0 for raw samples.
+ *          Without a name the available series are listed.
+ */
+static view_t *http_handle_series(view_t *view) {
+  json_t *json = &(json_t) {0};
+  series_query_t *query = &series_request;
+  series_t *series;
+  char name[STATUS_NAME_SIZE];
+  char value[12];
+
+  (void)view;
+
+  query_get(request->query, "name", name, sizeof(name));
+  series = series_find(name);
+  if (name[0] != '\0' && series == NULL) {
+    http_write_status(request->conn, 404);
+    return NULL;
+  }
+
+  query->to = series_now();
+  query_get(request->query, "to", value, sizeof(value));
+  if (value[0] != '\0') {
+    query->to = strtoul(value, NULL, 10);
+  }
+  query_get(request->query, "from", value, sizeof(value));
+  query->from = strtoul(value, NULL, 10);
+  query_get(request->query, "points", value, sizeof(value));
+  query->points = value[0] ? (int)strtol(value, NULL, 10)
+                           : SERIES_POINTS_DEFAULT;
+  query_get(request->query, "mode", value, sizeof(value));
+  query->mode = strcmp(value, "lttb") == 0 ? SERIES_LTTB : SERIES_BUCKETS;
+  query->buckets = series_buckets;
+
+  if (query->from > query->to || query->points < 1 ||
+      query->points > SERIES_POINTS_MAX ||
+      (value[0] != '\0' && strcmp(value, "lttb") != 0 &&
+       strcmp(value, "buckets") != 0)) {
+    http_write_status(request->conn, 400);
+    return NULL;
+  }
+
+  head_buffer->len = chsnprintf(head_buffer->data, BUFFER_SIZE,
+    "HTTP/1.1 200\r\n"
+    "Content-Type: application/json\r\n"
+    "Connection: close\r\n"
+    "\r\n"
+  );
+  netconn_write(request->conn, head_buffer->data, head_buffer->len,
+                NETCONN_COPY);
+
+  json_begin(json, json_buffer->data, JSON_BUFFER_SIZE, &fields);
+  json_sink(json, http_conn_flush, request->conn);
+
+  if (series == NULL) {
+    if (json_array_open(json, "series")) {
+      for (series = series_first(); series; series = series->next) {
+        json_string(json, NULL, series->name);
+      }
+      json_array_close(json);
+    }
+  } else {
+    json_string(json, "name", series->name);
+    json_uint(json, "from", query->from);
+    json_uint(json, "to", query->to);
+    json_string(json, "mode", query->mode == SERIES_LTTB ? "lttb" : "buckets");
+    if (json_array_open(json, "points")) {
+      series_query(series, query, http_series_point, json);
+      json_array_close(json);
+    }
+    json_uint(json, "period", query->period);
+  }
+
+  json_end(json);
+  json_flush(json);
+  return NULL;
+}
+
+/**
+ * @brief Prometheus text exposition, streamed through the body buffer.
+ */
+static view_t *http_handle_metrics(view_t *view) {
+  (void)view;
+
+  head_buffer->len = chsnprintf(head_buffer->data, BUFFER_SIZE,
+    "HTTP/1.1 200\r\n"
+    "Content-Type: text/plain; version=0.0.4\r\n"
+    "Connection: close\r\n"
+    "\r\n"
+  );
+  netconn_write(request->conn, head_buffer->data, head_buffer->len,
+                NETCONN_COPY);
+
+  metrics_render(body_buffer->data, BUFFER_SIZE, http_conn_flush,
+                 request->conn);
+  return NULL;
+}
+
+static view_t *http_samples_render(view_t *view, bool reset) {
+  (void)view;
+
+  head_buffer->len = chsnprintf(head_buffer->data, BUFFER_SIZE,
+    "HTTP/1.1 200\r\n"
+    "Content-Type: text/plain\r\n"
+    "Connection: close\r\n"
+    "\r\n"
+  );
+  netconn_write(request->conn, head_buffer->data, head_buffer->len,
+                NETCONN_COPY);
 
-  size_t body_len = strlen(raw);
-  memcpy(request->body, raw, body_len);
-  request->body[body_len] = '\0';
+  sampler_render(body_buffer->data, BUFFER_SIZE, http_conn_flush,
+                 request->conn, reset);
+  return NULL;
+}
+
+/**
+ * @brief Returns the sampled stacks in the folded format, ready for
+ *        flamegraph.pl once the addresses are resolved.
+ */
+static view_t *http_handle_samples_get(view_t *view) {
+  return http_samples_render(view, false);
 }
 
-static void http_server_serve(struct netconn *conn) {
-  struct netbuf *inbuf;
-  char *buf;
+/**
+ * @brief Same as GET, the samples are cleared after being read.
+ */
+static view_t *http_handle_samples_post(view_t *view) {
+  return http_samples_render(view, true);
+}
+
+/* Track of the thread slices, interrupts get their own and spans are on the
+   track of their thread.*/
+#define TRACE_TID_CPU           0
+#define TRACE_TID_IRQ           1
+
+typedef struct trace_view {
+  json_t *json;
+  const thread_t *current;
+  uint64_t start;
+} trace_view_t;
+
+static void http_trace_time(json_t *json, const char *key, uint64_t time) {
+  uint64_t ns = time * 1000 / (CPU_CYCLES_HZ / 1000000);
+  json_fixed(json, key, (unsigned long)(ns / 1000), (unsigned long)(ns % 1000));
+}
+
+static const char *http_trace_thread(const thread_t *thread) {
+  thread_t *tp = chRegFirstThread();
+  const char *name = "thread";
+
+  /* Threads that exited since are no longer in the registry.*/
+  while (tp) {
+    if (tp == thread && tp->name) {
+      name = tp->name;
+    }
+    tp = chRegNextThread(tp);
+  }
+  return name;
+}
+
+static void http_trace_event(void *arg, const trace_record_t *record,
+                             uint64_t time) {
+  trace_view_t *trace = arg;
+  json_t *json = trace->json;
+  const thread_t *current = trace->current;
+  uint64_t start = trace->start;
+  char name[16];
+
+  if (record->type == TRACE_SWITCH) {
+    trace->current = record->object;
+    trace->start = time;
+    /* The slice of the first thread started before the oldest record.*/
+    if (current == NULL) {
+      return;
+    }
+  }
+  if (!json_object_open(json, NULL)) {
+    return;
+  }
+  switch (record->type) {
+  case TRACE_SWITCH:
+    json_string(json, "name", http_trace_thread(current));
+    json_string(json, "ph", "X");
+    http_trace_time(json, "ts", start);
+    http_trace_time(json, "dur", time - start);
+    json_uint(json, "tid", TRACE_TID_CPU);
+    break;
+  case TRACE_IRQ_ENTER:
+  case TRACE_IRQ_LEAVE:
+    chsnprintf(name, sizeof(name), "vector %u", record->arg);
+    json_string(json, "name", name);
+    json_string(json, "ph", record->type == TRACE_IRQ_ENTER ? "B" : "E");
+    http_trace_time(json, "ts", time);
+    json_uint(json, "tid", TRACE_TID_IRQ);
+    break;
+  default:
+    json_string(json, "name", record->object);
+    json_string(json, "ph", record->type == TRACE_SPAN_BEGIN ? "B" : "E");
+    http_trace_time(json, "ts", time);
+    json_uint(json, "tid", (unsigned long)trace->current);
+    break;
+  }
+  json_uint(json, "pid", 1);
+  json_object_close(json);
+}
+
+static void http_trace_track(json_t *json, unsigned long tid,
+                             const char *name) {
+  if (json_object_open(json, NULL)) {
+    json_string(json, "name", "thread_name");
+    json_string(json, "ph", "M");
+    json_uint(json, "pid", 1);
+    json_uint(json, "tid", tid);
+    if (json_object_open(json, "args")) {
+      json_string(json, "name", name);
+      json_object_close(json);
+    }
+    json_object_close(json);
+  }
+}
+
+/**
+ * @brief Returns the trace ring in the Chrome trace event format.
+ * @details Loads in chrome://tracing and Perfetto. Thread slices are on the
+ *          "cpu" track, interrupts on "irq" and spans on the track of the
+ *          thread that opened them.
+ */
+static view_t *http_handle_trace(view_t *view) {
+  json_t *json = &(json_t) {0};
+  trace_view_t *trace = &(trace_view_t) {.json = json};
+  thread_t *tp;
+
+  (void)view;
+
+  head_buffer->len = chsnprintf(head_buffer->data, BUFFER_SIZE,
+    "HTTP/1.1 200\r\n"
+    "Content-Type: application/json\r\n"
+    "Connection: close\r\n"
+    "\r\n"
+  );
+  netconn_write(request->conn, head_buffer->data, head_buffer->len,
+                NETCONN_COPY);
+
+  json_begin(json, json_buffer->data, JSON_BUFFER_SIZE, &fields);
+  json_sink(json, http_conn_flush, request->conn);
+
+  json_string(json, "displayTimeUnit", "ns");
+  if (json_array_open(json, "traceEvents")) {
+    http_trace_track(json, TRACE_TID_CPU, "cpu");
+    http_trace_track(json, TRACE_TID_IRQ, "irq");
+    tp = chRegFirstThread();
+    while (tp) {
+      http_trace_track(json, (unsigned long)tp, tp->name ? tp->name : "thread");
+      tp = chRegNextThread(tp);
+    }
+    trace_export(http_trace_event, trace);
+    json_array_close(json);
+  }
+
+  json_end(json);
+  json_flush(json);
+  return NULL;
+}
+
+/**
+ * @brief Serves one request.
+ * @return true if the connection was handed over to a helper thread.
+ */
+static bool http_server_serve(struct netconn *conn) {
+  struct netbuf *inbuf = NULL;
   u16_t buflen;
+  bool parsed;
   err_t err;
 
+  request->conn = conn;
+  request->detached = false;
+
+  trace_begin("recv");
   err = netconn_recv(conn, &inbuf);
+  trace_end("recv");
+  http_mark(HTTP_MARK_RECEIVED);
 
   if (err == ERR_OK) {
-    netbuf_data(inbuf, (void **)&buf, &buflen);
-    buf[buflen] = '\0';
+    /* The request may span several pbufs and must be NUL terminated, it
+       is copied out instead of writing past the end of the netbuf.*/
+    buflen = netbuf_copy(inbuf, raw_buffer, REQUEST_SIZE - 1);
+    raw_buffer[buflen] = '\0';
+
+    trace_begin("dispatch");
+    request->route = ARRAY_SIZE(views);
+    parsed = request_parse(request, headers, raw_buffer);
+    http_mark(HTTP_MARK_PARSED);
+    if (parsed) {
+      http_dispatch(conn);
+    } else {
+      http_mark(HTTP_MARK_HANDLED);
+      netconn_write(conn, bad_request, strlen(bad_request), NETCONN_NOCOPY);
+      http_mark(HTTP_MARK_WRITTEN);
+    }
+    trace_end("dispatch");
 
-    request_parse((const char *)buf);
+    metric_add(&requests_metric, 1);
 
-    for (unsigned int i = 0; i < ARRAY_SIZE(views); i++) {
-      if (strcmp(request->url, views[i].path) == 0) {
-        view_t *view = NULL;
-        if ((strcmp(request->method, "GET") == 0) && views[i].get_handler) {
-          view = views[i].get_handler(&views[i]);
-        }
-        if ((strcmp(request->method, "POST") == 0) && views[i].post_handler) {
-          view = views[i].post_handler(&views[i]);
-        }
-        if (view) {
-          netconn_write(conn,
-                        view->response->head->data,
-                        view->response->head->len,
-                        NETCONN_NOCOPY);
-          netconn_write(conn,
-                        view->response->body->data,
-                        view->response->body->len,
-                        NETCONN_NOCOPY);
-        }
-      }
-    }
+    status_app.time = chVTGetSystemTimeX();
+    status_app.requests++;
+    strncpy(status_app.user, profile_user, sizeof(status_app.user) - 1);
+    status_publish_app(&status_app);
   }
-  /* Close the connection (server closes in HTTP) */
-  netconn_close(conn);
 
   /* Delete the buffer (netconn_recv gives us ownership,
    so we have to make sure to deallocate the buffer) */
   netbuf_delete(inbuf);
+
+  if (request->detached) {
+    return true;
+  }
+
+  /* Close the connection (server closes in HTTP) */
+  trace_begin("close");
+  netconn_close(conn);
+  trace_end("close");
+  if (err == ERR_OK) {
+    http_mark(HTTP_MARK_CLOSED);
+    http_latency_observe();
+    boot_mark(BOOT_SERVED);
+  }
+  return false;
 }
 
-mailbox_t mb[WEB_HELPER_THREADS];
-msg_t b[WEB_HELPER_THREADS][WEB_MAILBOX_SIZE];
 THD_WORKING_AREA(wa_http_helper[WEB_HELPER_THREADS], WEB_THREAD_STACK_SIZE);
 THD_FUNCTION(http_helper, p) {
   int i = (int)p;
@@ -447,11 +1773,25 @@ THD_FUNCTION(http_helper, p) {
 
   chThdSetPriority(WEB_THREAD_PRIORITY - 1);
 
-  chMBObjectInit(&mb[i], b[i], WEB_HELPER_THREADS);
+  chMBObjectInit(&mb[i], b[i], WEB_MAILBOX_SIZE);
+  locks_name(&mb[i], "http helper");
 
   while (chThdShouldTerminateX() == false) {
-   chMBFetchTimeout(&mb[i], &msg, TIME_INFINITE);
- }
+    helper_idle[i] = true;
+    if (chMBFetchTimeout(&mb[i], &msg, TIME_INFINITE) != MSG_OK) {
+      continue;
+    }
+
+    stream_t *stream = (stream_t *)msg;
+    if (stream->kind == STREAM_WEBSOCKET) {
+      ws_serve(stream->conn, stream->accept, http_ws_message);
+    } else {
+      events_serve(stream->conn, stream->interval);
+    }
+
+    netconn_close(stream->conn);
+    netconn_delete(stream->conn);
+  }
 }
 
 THD_WORKING_AREA(wa_http_server, WEB_THREAD_STACK_SIZE);
@@ -463,6 +1803,12 @@ THD_FUNCTION(http_server, p) {
   (void)p;
   chRegSetThreadName("http");
 
+  metrics_register(&requests_metric);
+  http_latency_register();
+
+  /* The listener is bound before link up, not after.*/
+  net_wait();
+
   /* Create a new TCP connection handle */
   conn = netconn_new(NETCONN_TCP);
   LWIP_ERROR("http_server: invalid conn", (conn != NULL), chThdExit(MSG_RESET););
@@ -472,6 +1818,7 @@ THD_FUNCTION(http_server, p) {
 
   /* Put the connection into LISTEN state */
   netconn_listen(conn);
+  boot_mark(BOOT_LISTEN);
 
   /* Goes to the final priority after initialization.*/
   chThdSetPriority(WEB_THREAD_PRIORITY);
@@ -480,8 +1827,11 @@ THD_FUNCTION(http_server, p) {
     err = netconn_accept(conn, &newconn);
     if (err != ERR_OK)
       continue;
-    http_server_serve(newconn);
-    netconn_delete(newconn);
+    http_mark(HTTP_MARK_ACCEPTED);
+    boot_mark(BOOT_ACCEPT);
+    if (!http_server_serve(newconn)) {
+      netconn_delete(newconn);
+    }
   }
 }
 
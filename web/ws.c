@@ -0,0 +1,531 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file ws.c
+ * @brief WebSocket server code.
+ * @details Each socket is owned by the helper thread running ws_serve(),
+ *          which is the only thread writing to it. Frames are unmasked in
+ *          place in the received pbufs and single chunk messages are handed
+ *          to the handler without copying.
+ *          Broadcast messages are encoded once into a ring of frames, every
+ *          socket thread sends the frames published since it last woke up.
+ *          A socket falling more than WS_RING_SIZE frames behind skips the
+ *          overwritten ones.
+ *          Socket threads sleep on events, raised by the netconn callback
+ *          when data arrives and by ws_broadcast(), and only time out for
+ *          the keepalive.
+ * @addtogroup WEB_WS
+ * @{
+ */
+
+#include <string.h>
+
+#include "ch.h"
+
+#include "hal.h" /* chprintf */
+#include "chprintf.h" /* chprintf */
+
+#include "lwip/opt.h"
+#include "lwip/arch.h"
+#include "lwip/api.h"
+
+#include "ws.h"
+
+#if LWIP_NETCONN
+
+#define WS_GUID "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+#define ROL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+#define WS_EVT_RECV             EVENT_MASK(0)
+#define WS_EVT_SEND             EVENT_MASK(1)
+
+typedef struct ws_slot {
+  volatile uint32_t seq;
+  size_t len;
+  uint8_t data[WS_FRAME_SIZE];
+} ws_slot_t;
+
+typedef struct ws_conn {
+  struct netconn *conn;
+  thread_t *thread;
+  ws_handler_t handler;
+  ws_parser_t parser;
+  uint32_t seq;
+  bool closing;
+  bool ping;
+  systime_t active;
+  size_t message_len;
+  uint8_t message[WS_MESSAGE_SIZE];
+  size_t control_len;
+  uint8_t control[125];
+} ws_conn_t;
+
+static const char base64[] =
+  "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static ws_slot_t ring[WS_RING_SIZE];
+
+static volatile uint32_t ring_head;
+
+static MUTEX_DECL(ring_mtx);
+
+static ws_conn_t ws_conns[WS_CONNECTIONS];
+
+static EVENTSOURCE_DECL(ws_event);
+
+static void sha1_block(uint32_t h[5], const uint8_t *block) {
+  uint32_t w[16];
+  uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+
+  for (int i = 0; i < 16; i++) {
+    w[i] = (uint32_t)block[4 * i] << 24 | (uint32_t)block[4 * i + 1] << 16 |
+           (uint32_t)block[4 * i + 2] << 8 | (uint32_t)block[4 * i + 3];
+  }
+
+  for (int i = 0; i < 80; i++) {
+    uint32_t f, k, t;
+    if (i >= 16) {
+      t = w[(i + 13) & 15] ^ w[(i + 8) & 15] ^ w[(i + 2) & 15] ^ w[i & 15];
+      w[i & 15] = ROL(t, 1);
+    }
+    if (i < 20) {
+      f = (b & c) | (~b & d);
+      k = 0x5A827999;
+    } else if (i < 40) {
+      f = b ^ c ^ d;
+      k = 0x6ED9EBA1;
+    } else if (i < 60) {
+      f = (b & c) | (b & d) | (c & d);
+      k = 0x8F1BBCDC;
+    } else {
+      f = b ^ c ^ d;
+      k = 0xCA62C1D6;
+    }
+    t = ROL(a, 5) + f + e + k + w[i & 15];
+    e = d;
+    d = c;
+    c = ROL(b, 30);
+    b = a;
+    a = t;
+  }
+
+  h[0] += a;
+  h[1] += b;
+  h[2] += c;
+  h[3] += d;
+  h[4] += e;
+}
+
+static void sha1(const uint8_t *data, size_t len, uint8_t digest[20]) {
+  uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+  uint8_t block[64];
+  uint64_t bits = (uint64_t)len * 8;
+  size_t n;
+
+  for (; len >= 64; len -= 64, data += 64) {
+    sha1_block(h, data);
+  }
+
+  memcpy(block, data, len);
+  block[len] = 0x80;
+  n = len + 1;
+  if (n > 56) {
+    memset(block + n, 0, 64 - n);
+    sha1_block(h, block);
+    n = 0;
+  }
+  memset(block + n, 0, 56 - n);
+  for (int i = 0; i < 8; i++) {
+    block[63 - i] = (uint8_t)(bits >> (8 * i));
+  }
+  sha1_block(h, block);
+
+  for (int i = 0; i < 20; i++) {
+    digest[i] = (uint8_t)(h[i / 4] >> (24 - 8 * (i % 4)));
+  }
+}
+
+/**
+ * @brief Computes Sec-WebSocket-Accept for @p key.
+ * @param accept buffer of WS_ACCEPT_SIZE bytes.
+ */
+void ws_accept(const char *key, char *accept) {
+  uint8_t text[64];
+  uint8_t digest[21];
+  size_t key_len = strlen(key);
+
+  if (key_len > sizeof(text) - strlen(WS_GUID)) {
+    key_len = sizeof(text) - strlen(WS_GUID);
+  }
+  memcpy(text, key, key_len);
+  memcpy(text + key_len, WS_GUID, strlen(WS_GUID));
+  sha1(text, key_len + strlen(WS_GUID), digest);
+  digest[20] = 0;
+
+  /* 20 bytes encode to 27 characters and one pad.*/
+  for (int i = 0; i < 21; i += 3) {
+    uint32_t v = (uint32_t)digest[i] << 16 | (uint32_t)digest[i + 1] << 8 |
+                 (uint32_t)digest[i + 2];
+    *accept++ = base64[(v >> 18) & 63];
+    *accept++ = base64[(v >> 12) & 63];
+    *accept++ = base64[(v >> 6) & 63];
+    *accept++ = (i + 2 < 20) ? base64[v & 63] : '=';
+  }
+  *accept = '\0';
+}
+
+static size_t ws_header(uint8_t *head, uint8_t opcode, size_t len) {
+  head[0] = 0x80 | opcode;
+  if (len < 126) {
+    head[1] = (uint8_t)len;
+    return 2;
+  }
+  head[1] = 126;
+  head[2] = (uint8_t)(len >> 8);
+  head[3] = (uint8_t)len;
+  return 4;
+}
+
+static bool ws_send(ws_conn_t *ws, uint8_t opcode,
+                    const uint8_t *data, size_t len) {
+  uint8_t head[4];
+  size_t head_len = ws_header(head, opcode, len);
+
+  if (netconn_write(ws->conn, head, head_len,
+                    NETCONN_COPY | (len ? NETCONN_MORE : 0)) != ERR_OK) {
+    return false;
+  }
+  return len == 0 || netconn_write(ws->conn, data, len, NETCONN_COPY) == ERR_OK;
+}
+
+static void ws_payload(ws_conn_t *ws, uint8_t *data, size_t len,
+                       bool first, bool last) {
+  ws_parser_t *p = &ws->parser;
+
+  switch (p->opcode) {
+  case WS_OP_CLOSE:
+  case WS_OP_PING:
+    if (first) {
+      ws->control_len = 0;
+    }
+    if (ws->control_len + len <= sizeof(ws->control)) {
+      memcpy(ws->control + ws->control_len, data, len);
+      ws->control_len += len;
+    }
+    if (last) {
+      /* Close is answered with the same status code.*/
+      ws_send(ws, p->opcode == WS_OP_PING ? WS_OP_PONG : WS_OP_CLOSE,
+              ws->control, p->opcode == WS_OP_PING ? ws->control_len :
+                           (ws->control_len < 2 ? ws->control_len : 2));
+      ws->closing |= (p->opcode == WS_OP_CLOSE);
+    }
+    break;
+  case WS_OP_PONG:
+    ws->ping = false;
+    break;
+  case WS_OP_TEXT:
+  case WS_OP_BINARY:
+  case WS_OP_CONTINUATION:
+    /* Unfragmented message in a single pbuf, no copy.*/
+    if (first && last && p->fin && ws->message_len == 0 &&
+        p->opcode != WS_OP_CONTINUATION) {
+      ws->handler(data, len);
+      break;
+    }
+    if (ws->message_len + len > sizeof(ws->message)) {
+      len = sizeof(ws->message) - ws->message_len;
+    }
+    memcpy(ws->message + ws->message_len, data, len);
+    ws->message_len += len;
+    if (last && p->fin) {
+      ws->handler(ws->message, ws->message_len);
+      ws->message_len = 0;
+    }
+    break;
+  default:
+    ws->closing = true;
+    break;
+  }
+}
+
+static size_t ws_head_size(const ws_parser_t *p) {
+  size_t size = 2;
+  if (p->head_len >= 2) {
+    uint8_t len7 = p->head[1] & 0x7F;
+    size += (len7 == 126) ? 2 : (len7 == 127) ? 8 : 0;
+    size += (p->head[1] & 0x80) ? 4 : 0;
+  }
+  return size;
+}
+
+/**
+ * @brief Parses @p len received bytes, unmasking the payload in place.
+ * @return false on a protocol error.
+ */
+static bool ws_parse(ws_conn_t *ws, uint8_t *data, size_t len) {
+  ws_parser_t *p = &ws->parser;
+
+  while (len > 0) {
+    if (!p->payload) {
+      size_t n = ws_head_size(p) - p->head_len;
+      if (n > len) {
+        n = len;
+      }
+      memcpy(p->head + p->head_len, data, n);
+      p->head_len += n;
+      data += n;
+      len -= n;
+      if (p->head_len < 2 || p->head_len < ws_head_size(p)) {
+        continue;
+      }
+
+      /* Client frames must be masked.*/
+      if ((p->head[1] & 0x80) == 0) {
+        return false;
+      }
+
+      uint8_t *q = p->head + 2;
+      p->fin = (p->head[0] & 0x80) != 0;
+      p->opcode = p->head[0] & 0x0F;
+      p->length = p->head[1] & 0x7F;
+      if (p->length == 126) {
+        p->length = (uint64_t)q[0] << 8 | q[1];
+        q += 2;
+      } else if (p->length == 127) {
+        p->length = 0;
+        for (int i = 0; i < 8; i++) {
+          p->length = p->length << 8 | q[i];
+        }
+        q += 8;
+      }
+      memcpy(p->mask, q, 4);
+      p->offset = 0;
+      p->head_len = 0;
+      p->payload = true;
+
+      if (p->length == 0) {
+        ws_payload(ws, data, 0, true, true);
+        p->payload = false;
+      }
+    } else {
+      size_t n = len;
+      if (n > p->length - p->offset) {
+        n = (size_t)(p->length - p->offset);
+      }
+      for (size_t i = 0; i < n; i++) {
+        data[i] ^= p->mask[(p->offset + i) & 3];
+      }
+      ws_payload(ws, data, n, p->offset == 0, p->offset + n == p->length);
+      p->offset += n;
+      data += n;
+      len -= n;
+      if (p->offset == p->length) {
+        p->payload = false;
+      }
+    }
+  }
+  return !ws->closing;
+}
+
+/* Sends the broadcast frames published since the last call.*/
+static bool ws_flush(ws_conn_t *ws) {
+  uint8_t frame[WS_FRAME_SIZE];
+
+  while (ws->seq != ring_head) {
+    uint32_t seq = ws->seq + 1;
+    if (ring_head - seq >= WS_RING_SIZE) {
+      seq = ring_head - WS_RING_SIZE + 1;
+    }
+    ws->seq = seq;
+
+    ws_slot_t *slot = &ring[seq % WS_RING_SIZE];
+    size_t len = slot->len;
+    memcpy(frame, slot->data, len);
+    __asm__ volatile ("" : : : "memory");
+    if (slot->seq != seq) {
+      continue;
+    }
+    if (netconn_write(ws->conn, frame, len, NETCONN_COPY) != ERR_OK) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+ * Netconn callback, runs in the tcpip thread. Wakes the socket thread on
+ * received data, close and errors.
+ */
+static void ws_netconn_event(struct netconn *conn, enum netconn_evt evt,
+                             u16_t len) {
+
+  (void)len;
+  if (evt != NETCONN_EVT_RCVPLUS && evt != NETCONN_EVT_ERROR) {
+    return;
+  }
+  chSysLock();
+  for (int i = 0; i < WS_CONNECTIONS; i++) {
+    if (ws_conns[i].conn == conn) {
+      chEvtSignalI(ws_conns[i].thread, WS_EVT_RECV);
+      break;
+    }
+  }
+  chSchRescheduleS();
+  chSysUnlock();
+}
+
+static ws_conn_t *ws_conn_alloc(void) {
+  ws_conn_t *ws = NULL;
+
+  chSysLock();
+  for (int i = 0; i < WS_CONNECTIONS; i++) {
+    if (ws_conns[i].conn == NULL) {
+      ws = &ws_conns[i];
+      ws->conn = (struct netconn *)-1;
+      break;
+    }
+  }
+  chSysUnlock();
+  return ws;
+}
+
+/**
+ * @brief Completes the handshake and runs a WebSocket session on @p conn.
+ * @details Called by the helper thread owning @p conn, returns when the
+ *          client closes, stops answering pings or on a protocol error.
+ * @param accept the Sec-WebSocket-Accept value, see ws_accept().
+ */
+void ws_serve(struct netconn *conn, const char *accept, ws_handler_t handler) {
+  ws_conn_t *ws = ws_conn_alloc();
+  char head[128];
+  size_t head_len;
+
+  if (ws == NULL) {
+    head_len = chsnprintf(head, sizeof(head),
+                          "HTTP/1.1 503\r\n"
+                          "Connection: close\r\n"
+                          "\r\n");
+    netconn_write(conn, head, head_len, NETCONN_COPY);
+    return;
+  }
+
+  head_len = chsnprintf(head, sizeof(head),
+                        "HTTP/1.1 101 Switching Protocols\r\n"
+                        "Upgrade: websocket\r\n"
+                        "Connection: Upgrade\r\n"
+                        "Sec-WebSocket-Accept: %s\r\n"
+                        "\r\n"
+                        ,accept);
+  if (netconn_write(conn, head, head_len, NETCONN_COPY) != ERR_OK) {
+    ws->conn = NULL;
+    return;
+  }
+
+  memset(&ws->parser, 0, sizeof(ws->parser));
+  ws->thread = chThdGetSelfX();
+  ws->conn = conn;
+  ws->handler = handler;
+  ws->seq = ring_head;
+  ws->closing = false;
+  ws->ping = false;
+  ws->active = chVTGetSystemTimeX();
+  ws->message_len = 0;
+
+  /* Data received before the callback is set is found by the first
+     non-blocking receive.*/
+  event_listener_t el;
+  chEvtGetAndClearEvents(WS_EVT_RECV | WS_EVT_SEND);
+  chEvtRegisterMask(&ws_event, &el, WS_EVT_SEND);
+  conn->callback = ws_netconn_event;
+
+  while (!ws->closing) {
+    struct pbuf *pb;
+    err_t err = netconn_recv_tcp_pbuf_flags(conn, &pb, NETCONN_DONTBLOCK);
+
+    if (err == ERR_OK) {
+      bool ok = true;
+      ws->active = chVTGetSystemTimeX();
+      ws->ping = false;
+      for (struct pbuf *q = pb; ok && q != NULL; q = q->next) {
+        ok = ws_parse(ws, q->payload, q->len);
+      }
+      pbuf_free(pb);
+      if (!ok) {
+        break;
+      }
+    } else if (err != ERR_WOULDBLOCK) {
+      break;
+    }
+
+    if (!ws_flush(ws)) {
+      break;
+    }
+
+    /* Keepalive, a client silent for two ping periods is dropped.*/
+    sysinterval_t idle = chTimeDiffX(ws->active, chVTGetSystemTimeX());
+    if (idle > TIME_MS2I(2 * WS_PING_MS)) {
+      break;
+    }
+    if (idle > TIME_MS2I(WS_PING_MS) && !ws->ping) {
+      ws->ping = true;
+      if (!ws_send(ws, WS_OP_PING, NULL, 0)) {
+        break;
+      }
+    }
+
+    /* More data may be queued, the receive is retried before sleeping.*/
+    if (err == ERR_WOULDBLOCK) {
+      sysinterval_t next = TIME_MS2I(ws->ping ? 2 * WS_PING_MS : WS_PING_MS);
+      chEvtWaitAnyTimeout(WS_EVT_RECV | WS_EVT_SEND, next - idle + 1);
+    }
+  }
+
+  conn->callback = NULL;
+  chEvtUnregister(&ws_event, &el);
+  ws->conn = NULL;
+}
+
+/**
+ * @brief Queues a text message for every connected socket.
+ * @details The frame is encoded once, messages longer than the ring slot
+ *          are truncated.
+ */
+void ws_broadcast(const uint8_t *data, size_t len) {
+  if (len > WS_FRAME_SIZE - 4) {
+    len = WS_FRAME_SIZE - 4;
+  }
+
+  chMtxLock(&ring_mtx);
+  uint32_t seq = ring_head + 1;
+  ws_slot_t *slot = &ring[seq % WS_RING_SIZE];
+  slot->seq = 0;
+  __asm__ volatile ("" : : : "memory");
+  size_t head_len = ws_header(slot->data, WS_OP_TEXT, len);
+  memcpy(slot->data + head_len, data, len);
+  slot->len = head_len + len;
+  __asm__ volatile ("" : : : "memory");
+  slot->seq = seq;
+  ring_head = seq;
+  chMtxUnlock(&ring_mtx);
+
+  chEvtBroadcast(&ws_event);
+}
+
+#endif
+
+/** @} */
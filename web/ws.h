@@ -0,0 +1,97 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file ws.h
+ * @brief WebSocket server macros and structures.
+ * @addtogroup WEB_WS
+ * @{
+ */
+
+#ifndef WS_H
+#define WS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef WS_PING_MS
+#define WS_PING_MS              5000
+#endif
+
+#ifndef WS_MESSAGE_SIZE
+#define WS_MESSAGE_SIZE         128
+#endif
+
+#ifndef WS_FRAME_SIZE
+#define WS_FRAME_SIZE           256
+#endif
+
+/**
+ * @brief Broadcast ring length, must be a power of two.
+ */
+#ifndef WS_RING_SIZE
+#define WS_RING_SIZE            8
+#endif
+
+#ifndef WS_CONNECTIONS
+#define WS_CONNECTIONS          4
+#endif
+
+#define WS_ACCEPT_SIZE          29
+
+#define WS_OP_CONTINUATION      0x0
+#define WS_OP_TEXT              0x1
+#define WS_OP_BINARY            0x2
+#define WS_OP_CLOSE             0x8
+#define WS_OP_PING              0x9
+#define WS_OP_PONG              0xA
+
+struct netconn;
+
+/**
+ * @brief Called with each complete message received from a client.
+ */
+typedef void (*ws_handler_t)(const uint8_t *data, size_t len);
+
+/**
+ * @brief Incremental frame parser state.
+ */
+typedef struct ws_parser {
+  uint8_t head[14];
+  uint8_t head_len;
+  bool payload;
+  bool fin;
+  uint8_t opcode;
+  uint8_t mask[4];
+  uint64_t length;
+  uint64_t offset;
+} ws_parser_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void ws_accept(const char *key, char *accept);
+  void ws_serve(struct netconn *conn, const char *accept,
+                ws_handler_t handler);
+  void ws_broadcast(const uint8_t *data, size_t len);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WS_H */
+
+/** @} */